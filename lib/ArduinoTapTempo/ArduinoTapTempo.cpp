@@ -53,9 +53,11 @@ bool ArduinoTapTempo::isChainActive()
   return isChainActive(millis());
 }
 
-bool ArduinoTapTempo::isChainActive(unsigned long ms)
+bool ArduinoTapTempo::isChainActive(uint32_t ms)
 {
-  return lastTapMS + maxBeatLengthMS > ms && lastTapMS + (beatLengthMS * beatsUntilChainReset) > ms;
+  // compare durations rather than points in time, so this keeps working when millis() wraps around
+  uint32_t sinceTap = ms - lastTapMS;
+  return sinceTap < maxBeatLengthMS && sinceTap < beatLengthMS * beatsUntilChainReset;
 }
 
 float ArduinoTapTempo::beatProgress()
@@ -63,20 +65,45 @@ float ArduinoTapTempo::beatProgress()
   return fmod((float)millisSinceReset / (float)beatLengthMS, 1.0);
 }
 
+void ArduinoTapTempo::setBeatLength(uint32_t ms)
+{
+  if(ms < minBeatLengthMS)
+    ms = minBeatLengthMS;
+  beatLengthMS = ms;
+}
+
+void ArduinoTapTempo::shiftPhase(int32_t ms)
+{
+  // keep the chain start in the past, moving it back by whole bars (of four beats)
+  while(ms < 0 && (uint32_t)(-ms) > millisSinceReset)
+    ms += beatLengthMS * 4;
+
+  lastResetMS -= ms;
+  millisSinceReset += ms;
+}
+
 void ArduinoTapTempo::update(bool buttonDown)
 {
-  unsigned long ms = millis();
+  update(buttonDown, millis());
+}
+
+void ArduinoTapTempo::update(bool buttonDown, uint32_t tapMS)
+{
+  update(buttonDown, tapMS, millis());
+}
 
+void ArduinoTapTempo::update(bool buttonDown, uint32_t tapMS, uint32_t ms)
+{
   // if a tap has occured...
   if(buttonDown && !buttonDownOld)
-    tap(ms);
+    tap(tapMS);
 
   buttonDownOld = buttonDown;
   millisSinceResetOld = millisSinceReset;
   millisSinceReset = ms - lastResetMS;
 }
 
-void ArduinoTapTempo::tap(unsigned long ms)
+void ArduinoTapTempo::tap(uint32_t ms)
 {
   // start a new tap chain if last tap was over an amount of beats ago
   if(!isChainActive(ms))
@@ -85,10 +112,10 @@ void ArduinoTapTempo::tap(unsigned long ms)
   addTapToChain(ms);
 }
 
-void ArduinoTapTempo::addTapToChain(unsigned long ms)
+void ArduinoTapTempo::addTapToChain(uint32_t ms)
 {
   // get time since last tap
-  unsigned long duration = ms - lastTapMS;
+  uint32_t duration = ms - lastTapMS;
 
   // reset beat to occur right now
   lastTapMS = ms;
@@ -127,7 +154,7 @@ void ArduinoTapTempo::resetTapChain()
   resetTapChain(millis());
 }
 
-void ArduinoTapTempo::resetTapChain(unsigned long ms)
+void ArduinoTapTempo::resetTapChain(uint32_t ms)
 {
   tapsInChain = 0;
   tapDurationIndex = 0;
@@ -137,17 +164,17 @@ void ArduinoTapTempo::resetTapChain(unsigned long ms)
   }
 }
 
-unsigned long ArduinoTapTempo::getAverageTapDuration()
+uint32_t ArduinoTapTempo::getAverageTapDuration()
 {
   int amount = tapsInChain - 1;
   if(amount > totalTapValues)
     amount = totalTapValues;
 
-  unsigned long runningTotalMS = 0;
+  uint32_t runningTotalMS = 0;
   for(int i = 0; i < amount; i++) {
     runningTotalMS += tapDurations[i];
   }
-  unsigned long avgTapDurationMS = runningTotalMS / amount;
+  uint32_t avgTapDurationMS = runningTotalMS / amount;
   if(avgTapDurationMS < minBeatLengthMS) {
     return minBeatLengthMS;
   }
@@ -36,16 +36,21 @@ class ArduinoTapTempo
     // Note that this may return true in rapid succession while tapping and setting the tempo to a slightly slower rate than the current tempo,
     // as the beat may occur and shortly afterward a new tap triggers a new beat
     bool isChainActive(); // returns true if the current tap chain is still accepting new taps to fine tune the tempo
-    bool isChainActive(unsigned long ms); // returns true if the current tap chain is still accepting new taps to fine tune the tempo
+    bool isChainActive(uint32_t ms); // returns true if the current tap chain is still accepting new taps to fine tune the tempo
     float getBPM(); // returns the number of beats per minute
     float beatProgress(); // returns a float from 0.0 to 1.0 indicating the percent through the current beat
     void resetTapChain(); // resets the current chain of taps and sets the start of the bar to the current time
-    void resetTapChain(unsigned long ms); // resets the current chain of taps and sets the start of the bar to the current time
+    void resetTapChain(uint32_t ms); // resets the current chain of taps and sets the start of the bar to the current time
 
-    inline unsigned long getBeatLength() { return beatLengthMS; } // returns the length of the beat in milliseconds
-    inline unsigned long getLastTapTime() { return lastTapMS; } // returns the time of the last tap in milliseconds since the program started
+    inline uint32_t getBeatLength() { return beatLengthMS; } // returns the length of the beat in milliseconds
+    inline uint32_t getLastTapTime() { return lastTapMS; } // returns the time of the last tap in milliseconds since the program started
+    inline uint32_t getMillisSinceReset() { return millisSinceReset; } // returns the milliseconds from the start of the tap chain to the last update(), e.g. to count beats or bars
 
+    void setBeatLength(uint32_t ms); // sets the tempo directly, e.g. to follow another device
+    void shiftPhase(int32_t ms); // moves the beat phase, positive values make the next beat arrive earlier
     void update(bool buttonDown); // call this each time you read your button state, accepts a boolean indicating if the button is down
+    void update(bool buttonDown, uint32_t tapMS); // same as update(), but a new tap is timed at tapMS (e.g. captured by an interrupt) instead of now
+    void update(bool buttonDown, uint32_t tapMS, uint32_t ms); // same as update(), but with the current time from another clock than millis()
 
     // getters and setters
 
@@ -57,9 +62,9 @@ class ArduinoTapTempo
     void setBeatsUntilChainReset(int beats); // The current chain of taps will finish this many beats after the most recent tap, accepts an int greater than 1
     void setTotalTapValues(int total); // Sets the maximum number of most recent taps that will be averaged out to calculate the tempo, accepts int from 2 to MAX_TAP_VALUES
     // increasing this allows the tempo to be more accurate compared to your tapping, but slower to respond to gradual changes in tapping speed.
-    inline void setMaxBeatLengthMS(unsigned long ms) { maxBeatLengthMS = ms; } // Sets the maximum beat length permissible.
+    inline void setMaxBeatLengthMS(uint32_t ms) { maxBeatLengthMS = ms; } // Sets the maximum beat length permissible.
     // If a tap attempts to set the beat length to anything greater than this value, the new tap will start a new chain and the tempo will remain unchanged.
-    inline void setMinBeatLengthMS(unsigned long ms) { minBeatLengthMS = ms; } // Sets the minimum beat length permissible.
+    inline void setMinBeatLengthMS(uint32_t ms) { minBeatLengthMS = ms; } // Sets the minimum beat length permissible.
     // If the average tap length is less than this value, then this value will be used instead.
     inline void setMaxBPM(float bpm) { minBeatLengthMS = 60000.0 / bpm; } // Sets the minimum beats per minute permissible.
     // This is another way of setting the minimum beat length.
@@ -69,8 +74,8 @@ class ArduinoTapTempo
 
   private:
     // config
-    unsigned long maxBeatLengthMS = 2000; // 30.0bpm
-    unsigned long minBeatLengthMS = 250; // 240.0bpm
+    uint32_t maxBeatLengthMS = 2000; // 30.0bpm
+    uint32_t minBeatLengthMS = 250; // 240.0bpm
     int beatsUntilChainReset = 3;
     int totalTapValues = 8;
     float skippedTapThresholdLow = 1.75;
@@ -80,23 +85,23 @@ class ArduinoTapTempo
     bool buttonDownOld = false;
 
     // timing
-    unsigned long millisSinceReset = 0;
-    unsigned long millisSinceResetOld = 0;
-    unsigned long beatLengthMS = 500;
-    unsigned long lastResetMS = millis();
+    uint32_t millisSinceReset = 0;
+    uint32_t millisSinceResetOld = 0;
+    uint32_t beatLengthMS = 500;
+    uint32_t lastResetMS = millis();
 
     // taps
-    unsigned long lastTapMS = 0;
-    unsigned long tapDurations[ArduinoTapTempo::MAX_TAP_VALUES];
+    uint32_t lastTapMS = 0;
+    uint32_t tapDurations[ArduinoTapTempo::MAX_TAP_VALUES];
     int tapDurationIndex = 0;
     int tapsInChain = 0;
     bool skippedTapDetection = true;
     bool lastTapSkipped = false;
 
     // private methods
-    void tap(unsigned long ms);
-    void addTapToChain(unsigned long ms);
-    unsigned long getAverageTapDuration();
+    void tap(uint32_t ms);
+    void addTapToChain(uint32_t ms);
+    uint32_t getAverageTapDuration();
 };
 
 #endif
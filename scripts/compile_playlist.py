@@ -0,0 +1,88 @@
+"""
+Compiles a human-readable playlist into the step table Sequencer plays.
+
+    python scripts/compile_playlist.py playlist.txt src/Playlist.h
+
+Each line is a step with a pattern, palette, drop flag and duration in bars:
+
+    # pattern   palette  drop  bars
+    bpm         ocean    -     8
+    random      keep     drop  2
+
+Patterns and palettes are named in the order of patternItems[] and paletteItems[]
+in main.cpp, or given as indexes. "keep" leaves the current one running,
+"random" picks one through FastRandom when the step is queued, see Sequencer.
+"""
+
+import sys
+
+PATTERNS = ["bpm", "heartbeat", "plasma", "juggle", "sinelon", "confetti", "vm", "fire"]
+PALETTES = ["ocean", "lava", "rainbow"]
+
+PATTERN_KEEP, PATTERN_RANDOM = 0xE, 0xF
+PALETTE_KEEP, PALETTE_RANDOM = 0x6, 0x7
+
+
+def parse_choice(value, names, keep, random, line_number):
+    if value == "keep":
+        return keep
+    if value == "random":
+        return random
+    if value in names:
+        return names.index(value)
+    if value.isdigit() and int(value) < keep:
+        return int(value)
+    raise ValueError("line %d: unknown value '%s', expected one of %s, keep or random" % (
+        line_number, value, ", ".join(names)))
+
+
+def parse(lines):
+    steps = []
+    for line_number, line in enumerate(lines, 1):
+        line = line.split("#")[0].strip()
+        if not line:
+            continue
+        parts = line.split()
+        if len(parts) != 4:
+            raise ValueError("line %d: expected 'pattern palette drop bars'" % line_number)
+
+        pattern = parse_choice(parts[0], PATTERNS, PATTERN_KEEP, PATTERN_RANDOM, line_number)
+        palette = parse_choice(parts[1], PALETTES, PALETTE_KEEP, PALETTE_RANDOM, line_number)
+        if parts[2] not in ("drop", "-"):
+            raise ValueError("line %d: drop should be 'drop' or '-'" % line_number)
+        drop = 1 if parts[2] == "drop" else 0
+        bars = int(parts[3])
+        if not 1 <= bars <= 255:
+            raise ValueError("line %d: bars should be between 1 and 255" % line_number)
+
+        steps.append(((pattern << 4) | (palette << 1) | drop, bars, line))
+    if not 1 <= len(steps) <= 255:
+        raise ValueError("playlist should have between 1 and 255 steps")
+    return steps
+
+
+def render(steps, source):
+    lines = [
+        "// Generated by scripts/compile_playlist.py from %s, don't edit by hand." % source,
+        "// See Sequencer.h for the step encoding.",
+        "",
+        "#define PLAYLIST_STEPS %d" % len(steps),
+        "",
+        "const byte playlist[PLAYLIST_STEPS * 2] PROGMEM = {",
+    ]
+    for flags, bars, text in steps:
+        lines.append("  0x%02X, %3d, // %s" % (flags, bars, text))
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("Usage: %s <playlist.txt> <output.h>" % sys.argv[0])
+    try:
+        with open(sys.argv[1]) as f:
+            steps = parse(f.readlines())
+    except ValueError as e:
+        sys.exit(str(e))
+    with open(sys.argv[2], "w") as f:
+        f.write(render(steps, sys.argv[1]))
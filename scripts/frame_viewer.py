@@ -0,0 +1,166 @@
+"""
+Shows frames streamed by the firmware (FRAME_STREAM, see src/FrameStreamer.h) live
+in a terminal with 24 bit colour, and reports compression and encoding cost per pattern.
+
+    python scripts/frame_viewer.py /dev/ttyUSB0                # needs pyserial
+    python scripts/frame_viewer.py /dev/ttyUSB0 115200 120,29
+
+Channel sizes default to the scarf and hat in main.cpp. Any text the firmware prints
+is passed through below the frames (DEBUG output is off while streaming).
+"""
+
+import sys
+
+START = (0xA7, 0x7A)
+OP_SKIP, OP_RUN, OP_RAW, OP_END = 0, 1, 2, 3
+PATTERNS = ["bpm", "heartbeat", "plasma", "juggle", "sinelon", "confetti", "vm", "fire"]
+ROW_LENGTH = 60
+
+
+class Decoder:
+    """Feed bytes in as they arrive, rebuilding the LEDs the firmware has sent"""
+
+    def __init__(self, size):
+        self.leds = [(0, 0, 0)] * size
+        self.text = bytearray()
+        self.reset()
+
+    def reset(self):
+        self.state = "idle"
+        self.header = []
+        self.frame_bytes = 0
+
+    def receive(self, b):
+        """Returns (pattern, encode micros, frame bytes) when a frame is complete"""
+        if self.state == "idle":
+            if b == START[0]:
+                self.state = "start"
+            else:
+                self.text.append(b)
+            return None
+        if self.state == "start":
+            if b != START[1]:
+                self.text.extend([START[0], b])
+                self.reset()
+                return None
+            self.state = "header"
+            self.frame_bytes = 2
+            self.index = 0
+            return None
+
+        self.frame_bytes += 1
+        if self.state == "header":
+            self.header.append(b)
+            if len(self.header) == 3:
+                self.state = "op"
+            return None
+
+        if self.state == "op":
+            op, length = b >> 6, (b & 0x3F) + 1
+            if op == OP_END:
+                pattern, micros = self.header[0], self.header[1] | (self.header[2] << 8)
+                size, complete = self.frame_bytes, self.index == len(self.leds)
+                self.reset()
+                return (pattern, micros, size) if complete else None
+            if self.index + length > len(self.leds):
+                # Misread, e.g. a start sequence inside colour data. The next keyframe
+                # (every 30 frames, see STREAM_KEYFRAME_INTERVAL) fixes it up.
+                self.reset()
+                return None
+            if op == OP_SKIP:
+                self.index += length
+            else:
+                self.op, self.remaining, self.colour = op, length, []
+                self.state = "colour"
+            return None
+
+        self.colour.append(b)
+        if len(self.colour) == 3:
+            colour, self.colour = tuple(self.colour), []
+            if self.op == OP_RUN:
+                for i in range(self.remaining):
+                    self.leds[self.index + i] = colour
+                self.index += self.remaining
+                self.remaining = 0
+            else:
+                self.leds[self.index] = colour
+                self.index += 1
+                self.remaining -= 1
+            if self.remaining == 0:
+                self.state = "op"
+        return None
+
+
+class Stats:
+    def __init__(self):
+        self.frames = 0
+        self.bytes = 0
+        self.timed = 0
+        self.micros = 0
+
+
+def render(leds, sizes):
+    lines = []
+    offset = 0
+    for size in sizes:
+        for row in range(offset, offset + size, ROW_LENGTH):
+            pixels = leds[row:min(row + ROW_LENGTH, offset + size)]
+            lines.append("".join("\x1b[38;2;%d;%d;%dm█" % p for p in pixels) + "\x1b[0m")
+        offset += size
+    return lines
+
+
+def report(stats, led_count):
+    raw = led_count * 3
+    print("%-10s %8s %10s %12s" % ("pattern", "frames", "ratio", "encode us"))
+    for pattern, s in sorted(stats.items()):
+        name = PATTERNS[pattern] if pattern < len(PATTERNS) else str(pattern)
+        print("%-10s %8d %9.1fx %12.0f" % (
+            name, s.frames, raw * s.frames / max(s.bytes, 1), s.micros / max(s.timed, 1)))
+
+
+def main(port_name, baud_rate, sizes):
+    import serial  # pyserial
+
+    decoder = Decoder(sum(sizes))
+    stats = {}
+    previous = None
+    first = True
+    with serial.Serial(port_name, baud_rate, timeout=0.1) as port:
+        try:
+            while True:
+                for b in port.read(max(1, port.in_waiting)):
+                    result = decoder.receive(b)
+                    if result is None:
+                        continue
+                    pattern, micros, size = result
+                    current = stats.setdefault(pattern, Stats())
+                    current.frames += 1
+                    current.bytes += size
+                    # Encoding time is reported with the next frame
+                    if previous is not None:
+                        stats[previous].timed += 1
+                        stats[previous].micros += micros
+                    previous = pattern
+
+                    lines = render(decoder.leds, sizes)
+                    if not first:
+                        sys.stdout.write("\x1b[%dA" % len(lines))
+                    first = False
+                    sys.stdout.write("\n".join(lines) + "\n")
+                    sys.stdout.flush()
+                if b"\n" in decoder.text:
+                    sys.stderr.write(decoder.text.decode(errors="replace"))
+                    decoder.text.clear()
+                    first = True
+        except KeyboardInterrupt:
+            print()
+            report(stats, sum(sizes))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in (2, 3, 4):
+        sys.exit("Usage: %s <serial port> [baud rate] [channel sizes]" % sys.argv[0])
+    baud_rate = int(sys.argv[2]) if len(sys.argv) > 2 else 115200
+    sizes = [int(s) for s in sys.argv[3].split(",")] if len(sys.argv) > 3 else [120, 29]
+    main(sys.argv[1], baud_rate, sizes)
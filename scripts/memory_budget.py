@@ -0,0 +1,185 @@
+"""
+Reports static SRAM, heap at boot and flash usage per class/global of the firmware ELF,
+and fails the build when it exceeds the limits in memory_budget.json.
+
+Runs after every PlatformIO build (see extra_scripts in platformio.ini),
+or standalone:
+
+    python scripts/memory_budget.py .pioenvs/nanoatmega328/firmware.elf
+
+Limits are the measured usage ("baseline" in memory_budget.json) plus headroom_percent.
+Limits missing from the budget (e.g. on a fresh checkout) are recorded from the ELF
+being checked. After a deliberate change, re-measure all of them with:
+
+    python scripts/memory_budget.py --update .pioenvs/nanoatmega328/firmware.elf
+
+Heap at boot (the new'ed patterns and palettes) is read from the heap_<name> symbols
+main.cpp records with MEMORY_REPORT_HEAP, i.e. sizeof() plus allocator overhead.
+With DEBUG, the firmware prints the actual heap at boot to compare against.
+"""
+
+import json
+import os
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BUDGET_FILE = os.path.join(ROOT, "memory_budget.json")
+
+RAM_TYPES = "bBdD"
+FLASH_TYPES = "tTrRdDwWvV"
+
+
+def section_sizes(size_tool, elf):
+    """Section sizes from `avr-size -A`, which include alignment and padding"""
+    sizes = {}
+    output = subprocess.check_output([size_tool, "-A", elf]).decode()
+    for line in output.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def group_name(symbol):
+    """Group symbols by class, e.g. 'Heartbeat::loop(unsigned char)' is 'Heartbeat'"""
+    symbol = re.sub(r"^(vtable|typeinfo|typeinfo name) for ", "", symbol)
+    if "::" in symbol:
+        symbol = symbol.split("::")[0]
+    symbol = symbol.split("(")[0].split("<")[0].strip()
+    return symbol or "(anonymous)"
+
+
+def heap_groups(nm_tool, elf):
+    """Absolute heap_<name> symbols, their value is the heap taken in bytes"""
+    heap = {}
+    output = subprocess.check_output([nm_tool, "-t", "d", elf]).decode()
+    for line in output.splitlines():
+        match = re.match(r"^(\d+)\s+[aA]\s+heap_(\w+)$", line)
+        if match:
+            heap[match.group(2)] = int(match.group(1))
+    return heap
+
+
+def symbol_groups(nm_tool, elf):
+    ram = defaultdict(int)
+    flash = defaultdict(int)
+    output = subprocess.check_output([nm_tool, "-C", "-S", "--size-sort", "-t", "d", elf]).decode()
+    for line in output.splitlines():
+        match = re.match(r"^\d+\s+(\d+)\s+(\w)\s+(.*)$", line)
+        if not match:
+            continue
+        size, kind, symbol = int(match.group(1)), match.group(2), match.group(3)
+        group = group_name(symbol)
+        if kind in RAM_TYPES:
+            ram[group] += size
+        if kind in FLASH_TYPES:
+            flash[group] += size
+    return ram, flash
+
+
+def print_table(title, groups, limit=20):
+    print("%s:" % title)
+    for group, size in sorted(groups.items(), key=lambda item: -item[1])[:limit]:
+        print("  %6d  %s" % (size, group))
+
+
+def with_headroom(size, budget):
+    """Limit for a measured size, rounded up to 8 bytes"""
+    limit = size * (100 + budget["headroom_percent"]) // 100
+    return (limit + 7) // 8 * 8
+
+
+def record(budget, measured, update):
+    """Set limits from measured usage, only the missing ones unless updating"""
+    changed = False
+    baseline = budget.setdefault("baseline", {})
+    for key in ("ram", "heap", "flash"):
+        if update or key not in budget:
+            baseline[key] = measured[key]
+            budget[key] = with_headroom(measured[key], budget)
+            changed = True
+    for key in ("ram_groups", "heap_groups"):
+        groups = budget.setdefault(key, {})
+        for group in groups:
+            if update:
+                baseline.setdefault(key, {})[group] = measured[key].get(group, 0)
+                groups[group] = with_headroom(measured[key].get(group, 0), budget)
+                changed = True
+    if changed:
+        print("Recorded %s baseline in %s:" % ("a new" if update else "a missing", BUDGET_FILE))
+        print(json.dumps(baseline, indent=2, sort_keys=True))
+        with open(BUDGET_FILE, "w") as f:
+            json.dump(budget, f, indent=2)
+            f.write("\n")
+
+
+def check(elf, size_tool, nm_tool, update=False):
+    with open(BUDGET_FILE) as f:
+        budget = json.load(f)
+
+    sections = section_sizes(size_tool, elf)
+    ram = sections.get(".data", 0) + sections.get(".bss", 0)
+    flash = sections.get(".text", 0) + sections.get(".data", 0)
+    ram_groups, flash_groups = symbol_groups(nm_tool, elf)
+    heap_by_group = heap_groups(nm_tool, elf)
+    heap = sum(heap_by_group.values())
+    record(budget, {
+        "ram": ram, "heap": heap, "flash": flash,
+        "ram_groups": ram_groups, "heap_groups": heap_by_group,
+    }, update)
+
+    print_table("Static SRAM per class/global (bytes)", ram_groups)
+    print_table("Heap at boot per class (bytes)", heap_by_group)
+    print_table("Flash per class/global (bytes)", flash_groups)
+    print("SRAM:  %d of %d bytes budgeted" % (ram, budget["ram"]))
+    print("Heap:  %d of %d bytes budgeted at boot, %d left for the stack" % (
+        heap, budget["heap"], budget["ram_size"] - ram - heap))
+    print("Flash: %d of %d bytes budgeted" % (flash, budget["flash"]))
+
+    errors = []
+    if ram > budget["ram"]:
+        errors.append("static SRAM %d exceeds budget of %d bytes" % (ram, budget["ram"]))
+    if not heap_by_group:
+        errors.append("no heap_ symbols found, see MEMORY_REPORT_HEAP in main.cpp")
+    if heap > budget["heap"]:
+        errors.append("heap at boot %d exceeds budget of %d bytes" % (heap, budget["heap"]))
+    if flash > budget["flash"]:
+        errors.append("flash %d exceeds budget of %d bytes" % (flash, budget["flash"]))
+    for group, limit in budget.get("ram_groups", {}).items():
+        if ram_groups.get(group, 0) > limit:
+            errors.append("%s uses %d bytes of SRAM, budget is %d" % (group, ram_groups[group], limit))
+    for group, limit in budget.get("heap_groups", {}).items():
+        if heap_by_group.get(group, 0) > limit:
+            errors.append("%s uses %d bytes of heap, budget is %d" % (group, heap_by_group[group], limit))
+
+    for error in errors:
+        print("Memory budget exceeded: %s" % error)
+    return len(errors) == 0
+
+
+def toolchain_tool(cc, name):
+    """Derive e.g. avr-nm from avr-gcc"""
+    return re.sub(r"gcc(\.exe)?$", name + r"\1", cc)
+
+
+try:
+    Import("env")  # noqa: F821, only defined when run by PlatformIO (SCons)
+
+    def after_build(source, target, env):
+        cc = env.subst("$CC")
+        if not check(str(target[0]), toolchain_tool(cc, "size"), toolchain_tool(cc, "nm")):
+            env.Exit(1)
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", after_build)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        args = sys.argv[1:]
+        update = "--update" in args
+        if update:
+            args.remove("--update")
+        if len(args) != 1:
+            sys.exit("Usage: %s [--update] <firmware.elf>" % sys.argv[0])
+        sys.exit(0 if check(args[0], "avr-size", "avr-nm", update) else 1)
@@ -0,0 +1,117 @@
+"""
+Controls the outfit over serial, see src/RemoteControl.h for the protocol.
+
+    python scripts/remote.py /dev/ttyUSB0 pattern juggle      # needs pyserial
+    python scripts/remote.py /dev/ttyUSB0 palette lava
+    python scripts/remote.py /dev/ttyUSB0 tempo 128 [bar phase in ms]
+    python scripts/remote.py /dev/ttyUSB0 drop on|off
+    python scripts/remote.py /dev/ttyUSB0 brightness 0-2
+    python scripts/remote.py /dev/ttyUSB0 stats
+    python scripts/remote.py /dev/ttyUSB0 ping [count]
+
+"ping" is a loopback test: It sends random payloads, and checks they come back unchanged.
+Patterns and palettes are named like in scripts/compile_playlist.py, or given as indexes.
+"""
+
+import os
+import struct
+import sys
+import time
+
+START = bytes([0xA9, 0x9A])
+MAX_PAYLOAD = 16
+REPLY = 0x80
+BAUD_RATE = 9600
+
+SET_PATTERN, SET_PALETTE, SET_BEAT, DROP, SET_BRIGHTNESS, QUERY_STATS, PING = range(1, 8)
+
+PATTERNS = ["bpm", "heartbeat", "plasma", "juggle", "sinelon", "confetti", "vm", "fire"]
+PALETTES = ["ocean", "lava", "rainbow"]
+
+
+def frame(command, payload=b""):
+    if len(payload) > MAX_PAYLOAD:
+        raise ValueError("payload is %d bytes, max. %d" % (len(payload), MAX_PAYLOAD))
+    checksum = command ^ len(payload)
+    for b in payload:
+        checksum ^= b
+    return START + bytes([command, len(payload)]) + bytes(payload) + bytes([checksum])
+
+
+def read_reply(port, command, timeout=2):
+    """Returns the payload of the reply to a command, skipping anything else (e.g. DEBUG output)"""
+    deadline = time.time() + timeout
+    buffer = b""
+    while time.time() < deadline:
+        buffer += port.read(max(1, port.in_waiting))
+        start = buffer.find(START)
+        if start < 0 or len(buffer) < start + 4:
+            continue
+        length = buffer[start + 3]
+        end = start + 5 + length
+        if len(buffer) < end:
+            continue
+        if buffer[start:end] == frame(buffer[start + 2], buffer[start + 4:end - 1]) \
+                and buffer[start + 2] == command | REPLY:
+            return buffer[start + 4:end - 1]
+        buffer = buffer[start + 1:]
+    raise TimeoutError("no reply to command %d" % command)
+
+
+def index(value, names):
+    if value in names:
+        return names.index(value)
+    if value.isdigit():
+        return int(value)
+    raise ValueError("unknown value '%s', expected one of %s or an index" % (value, ", ".join(names)))
+
+
+def run(port, command, args):
+    if command == "pattern":
+        port.write(frame(SET_PATTERN, [index(args[0], PATTERNS)]))
+    elif command == "palette":
+        port.write(frame(SET_PALETTE, [index(args[0], PALETTES)]))
+    elif command == "tempo":
+        beat_length = round(60000 / float(args[0]))
+        bar_phase = int(args[1]) if len(args) > 1 else 0xFFFF
+        port.write(frame(SET_BEAT, struct.pack("<HH", beat_length, bar_phase)))
+    elif command == "drop":
+        port.write(frame(DROP, [1 if args[0] == "on" else 0]))
+    elif command == "brightness":
+        port.write(frame(SET_BRIGHTNESS, [int(args[0])]))
+    elif command == "stats":
+        port.write(frame(QUERY_STATS))
+        pattern, palette, brightness, flags, beat_length, free_bytes, latency, lost = \
+            struct.unpack("<BBBBHHHI", read_reply(port, QUERY_STATS))
+        print("pattern:     %s" % (PATTERNS[pattern] if pattern < len(PATTERNS) else pattern))
+        print("palette:     %s" % (PALETTES[palette] if palette < len(PALETTES) else palette))
+        print("brightness:  %d" % brightness)
+        print("dropping:    %s" % ("yes" if flags & 1 else "no"))
+        print("autopilot:   %s" % ("on" if flags & 2 else "off"))
+        print("bpm:         %.1f" % (60000 / beat_length))
+        print("free bytes:  %d (min.)" % free_bytes)
+        print("latency:     %dms" % latency)
+        print("clock lost:  %dms" % lost)
+    elif command == "ping":
+        count = int(args[0]) if args else 10
+        for i in range(count):
+            payload = os.urandom(1 + i % MAX_PAYLOAD)
+            sent = time.time()
+            port.write(frame(PING, payload))
+            if read_reply(port, PING) != payload:
+                sys.exit("ping %d: payload mismatch" % i)
+            print("ping %d: %d bytes, %.0fms" % (i, len(payload), (time.time() - sent) * 1000))
+    else:
+        raise ValueError("unknown command '%s'" % command)
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 3:
+        sys.exit("Usage: %s <serial port> <command> [arguments]" % sys.argv[0])
+    import serial  # pyserial
+    with serial.Serial(sys.argv[1], BAUD_RATE, timeout=0.1) as port:
+        time.sleep(2)  # opening the port resets the Nano
+        try:
+            run(port, sys.argv[2], sys.argv[3:])
+        except (ValueError, IndexError, TimeoutError) as e:
+            sys.exit(str(e))
@@ -0,0 +1,531 @@
+/**
+ * Times the render and output paths of the firmware on the host.
+ * Build and run with SOAK_SANITIZE=0 scripts/soak/run.sh bench [section...].
+ *
+ * Runs setup() from main.cpp, then times each section's work in a loop,
+ * taking the best of BENCH_ROUNDS rounds. Host nanoseconds say little about the Nano's
+ * 16MHz AVR, so every section times a reference next to what it measures
+ * (e.g. the passes it replaces), and the ratio is what to compare across changes.
+ *
+ * Build flags (e.g. -DOUTPUT_GAMMA -DOUTPUT_DITHER) go into SOAK_FLAGS, see run.sh.
+ */
+#include <chrono>
+#include <inttypes.h>
+#include <Host.h>
+#include <main.cpp>
+
+#define BENCH_ROUNDS 5
+#define BENCH_ROUND_NANOS 20000000 // at least, per round
+#define BENCH_LEDS 120 // a scarf channel
+
+// As in main.cpp
+const char *patternNames[] = {"Bpm", "Heartbeat", "Plasma", "Juggle", "Sinelon", "Confetti", "VmPattern", "Fire"};
+
+int failures = 0;
+
+/**
+ * Folds results in, so the compiler can't drop the work being timed
+ */
+volatile uint32_t benchSink;
+
+void sink(const CRGB *leds, uint16_t size)
+{
+  uint32_t sum = 0;
+  for (uint16_t i = 0; i < size; i++) {
+    sum = sum * 31 + leds[i].r + leds[i].g + leds[i].b;
+  }
+  benchSink = benchSink + sum;
+}
+
+/**
+ * @param items Items (e.g. LEDs) handled per call of work()
+ * @return Nanoseconds per item, best of BENCH_ROUNDS
+ */
+template<class F> double nanosPer(uint32_t items, F work)
+{
+  double best = 1e30;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    uint32_t calls = 0;
+    auto start = std::chrono::steady_clock::now();
+    int64_t nanos;
+    do {
+      work();
+      calls++;
+      nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    } while (nanos < BENCH_ROUND_NANOS);
+    best = min(best, (double)nanos / calls / items);
+  }
+  return best;
+}
+
+/**
+ * Move simulated time on, for patterns and beats that follow it
+ */
+void advance(uint32_t micros)
+{
+  soakMicros += micros;
+  systemClock.update();
+}
+
+/**
+ * A frame with something of everything: black, dim and full LEDs
+ */
+void randomFrame(CRGB *leds, uint16_t size)
+{
+  for (uint16_t i = 0; i < size; i++) {
+    byte level = (i % 3) ? random8() : 0;
+    leds[i] = CRGB(scale8(random8(), level), scale8(random8(), level), scale8(random8(), level));
+  }
+}
+
+void row(const char *name, double nanos, double reference)
+{
+  printf("  %-28s %8.2f ns/LED %9.0f ns/frame %6.2fx\n", name, nanos, nanos * BENCH_LEDS, nanos / reference);
+}
+
+#if defined(OUTPUT_DITHER_ERROR)
+  #define BENCH_OUTPUT_VARIANT "16 bit gamma, error diffusion"
+#elif defined(OUTPUT_DITHER)
+  #define BENCH_OUTPUT_VARIANT "16 bit gamma, ordered dither"
+#else
+  #define BENCH_OUTPUT_VARIANT "8 bit gamma"
+#endif
+
+/**
+ * Distinct levels a ramp of all 256 input levels comes out as at a brightness,
+ * averaged over 8 frames as the eye would with dithering (user-040)
+ */
+int outputLevels(byte brightness)
+{
+  static CRGB ramp[256], out[256];
+  static byte error[256 * 3];
+  static uint16_t sums[256];
+  memset(sums, 0, sizeof(sums));
+  memset(error, 0, sizeof(error));
+  for (int i = 0; i < 256; i++) {
+    ramp[i] = CRGB(i, i, i);
+  }
+  for (byte frame = 0; frame < 8; frame++) {
+    // One LED at a time, so every level sees every dither threshold
+    for (int i = 0; i < 256; i++) {
+      OutputStage::apply(ramp + i, ramp + i, 255, out + i, 1, UncorrectedColor, brightness, frame, error + i * 3);
+      sums[i] += out[i].r;
+    }
+  }
+  int levels = 1;
+  for (int i = 1; i < 256; i++) {
+    levels += sums[i] != sums[i - 1];
+  }
+  return levels;
+}
+
+/**
+ * OutputStage::apply(), against the separate passes it fuses (user-028)
+ */
+void benchOutput()
+{
+  static CRGB frame[BENCH_LEDS], out[BENCH_LEDS];
+  static byte error[BENCH_LEDS * 3];
+  randomFrame(frame, BENCH_LEDS);
+  byte brightness = 40;
+  uint32_t correction = TypicalLEDStrip;
+
+  printf("Output stage, %d LEDs, brightness %d\n", BENCH_LEDS, brightness);
+  // What a frame costs without any output stage: a copy into the front buffer
+  double copy = nanosPer(BENCH_LEDS, [&]() {
+    memcpy(out, frame, sizeof(frame));
+    sink(out, BENCH_LEDS);
+  });
+  double passes = nanosPer(BENCH_LEDS, [&]() {
+    memcpy(out, frame, sizeof(frame));
+    for (uint16_t i = 0; i < BENCH_LEDS; i++) {
+      out[i].r = pgm_read_byte(&gamma8[out[i].r]);
+      out[i].g = pgm_read_byte(&gamma8[out[i].g]);
+      out[i].b = pgm_read_byte(&gamma8[out[i].b]);
+    }
+    for (uint16_t i = 0; i < BENCH_LEDS; i++) {
+      out[i].r = scale8_video(out[i].r, (correction >> 16) & 0xFF);
+      out[i].g = scale8_video(out[i].g, (correction >> 8) & 0xFF);
+      out[i].b = scale8_video(out[i].b, correction & 0xFF);
+    }
+    for (uint16_t i = 0; i < BENCH_LEDS; i++) {
+      out[i].r = scale8_video(out[i].r, brightness);
+      out[i].g = scale8_video(out[i].g, brightness);
+      out[i].b = scale8_video(out[i].b, brightness);
+    }
+    sink(out, BENCH_LEDS);
+  });
+  byte ditherFrame = 0;
+  double fused = nanosPer(BENCH_LEDS, [&]() {
+    OutputStage::apply(frame, frame, 255, out, BENCH_LEDS, correction, brightness, ditherFrame++, error);
+    sink(out, BENCH_LEDS);
+  });
+  row("copy (no output stage)", copy, passes);
+  row("gamma, correction, brightness", passes, passes);
+  row("OutputStage::apply()", fused, passes);
+  printf("  %s: %d, %d and %d distinct levels at brightness 20, 40 and 60\n",
+    BENCH_OUTPUT_VARIANT, outputLevels(20), outputLevels(40), outputLevels(60));
+}
+
+/**
+ * Moving dots with fading trails, through PatternState::fadeActiveToBlackBy()
+ * and through fadeToBlackBy() over the whole strip, at 60 fps (user-029)
+ * @param dots 1 as in Sinelon, 8 as in Juggle
+ */
+void benchActive(uint16_t size, byte dots)
+{
+  CRGB *full = new CRGB[size];
+  CRGB *leds = new CRGB[size];
+  byte *active = new byte[(size + 7) / 8];
+  PatternState state(size, leds, active);
+  memset((byte *)full, 0, size * sizeof(CRGB));
+  uint64_t lit = 0;
+  uint32_t frames = 0;
+
+  auto draw = [&](CRGB *target) {
+    for (byte i = 0; i < dots; i++) {
+      uint16_t pos = beatsin16(dots == 1 ? 15 : i + 7, 0, size - 1);
+      target[pos] |= CHSV(i * 32, 200, 255);
+      if (target == leds) {
+        state.markActive(pos);
+      }
+    }
+  };
+  // Let the trails build up first
+  for (int i = 0; i < 600; i++) {
+    advance(16667);
+    fadeToBlackBy(full, size, 20);
+    draw(full);
+    state.fadeActiveToBlackBy(20);
+    draw(leds);
+  }
+  double everything = nanosPer(size, [&]() {
+    advance(16667);
+    fadeToBlackBy(full, size, 20);
+    draw(full);
+    sink(full, 1);
+  });
+  double tracked = nanosPer(size, [&]() {
+    advance(16667);
+    state.fadeActiveToBlackBy(20);
+    draw(leds);
+    sink(leds, 1);
+    for (uint16_t i = 0; i < size; i++) {
+      lit += leds[i] ? 1 : 0;
+    }
+    frames++;
+  });
+  // Counting lit LEDs above isn't part of the work, take it back out
+  double counting = nanosPer(size, [&]() {
+    for (uint16_t i = 0; i < size; i++) {
+      lit += leds[i] ? 1 : 0;
+    }
+    frames++;
+    sink(leds, 1);
+  });
+  double fadedLeds = (double)lit / frames;
+  printf("  %4d LEDs, %d dot%s: fades %4d vs %5.1f LEDs (%4.1fx fewer), host %5.0f vs %5.0f ns/frame (%4.1fx)\n",
+    size, dots, dots == 1 ? " " : "s", size, fadedLeds, size / fadedLeds,
+    everything * size, (tracked - counting) * size, everything / (tracked - counting));
+
+  delete[] full;
+  delete[] leds;
+  delete[] active;
+}
+
+void benchActive()
+{
+  printf("Fading trails at 60 fps, the whole strip against only lit LEDs\n");
+  uint16_t sizes[] = {120, 600};
+  for (uint16_t size : sizes) {
+    benchActive(size, 1);
+    benchActive(size, 8);
+  }
+}
+
+/**
+ * Render a pattern on all channels, a frame length after the last one
+ * @return Nanoseconds per frame
+ */
+double renderNanos(Pattern *pattern)
+{
+  pattern->setup();
+  return nanosPer(1, [&]() {
+    advance(pattern->getFrameLength() * 1000);
+    prepareFrame(pattern, false, systemClock.millis());
+    pattern->loop(0, ALL_STATES);
+    sink(channels.getState(0)->leds, 1);
+  });
+}
+
+/**
+ * Per pattern, CPU time to show 1000 / OUTPUT_FRAME_LENGTH frames per second,
+ * rendering every one of them or rendering keyframes at the pattern's own rate
+ * and blending between them, see OUTPUT_INTERPOLATION (user-030)
+ */
+void benchInterpolation()
+{
+  static CRGB from[Channels::totalSize], to[Channels::totalSize], out[Channels::totalSize];
+  randomFrame(from, Channels::totalSize);
+  randomFrame(to, Channels::totalSize);
+  double blend = nanosPer(1, [&]() {
+    OutputStage::interpolate(from, to, 128, out, Channels::totalSize);
+    sink(out, 1);
+  });
+
+  double outputRate = 1000.0 / OUTPUT_FRAME_LENGTH;
+  printf("Interpolation, %d LEDs at %.0f fps, blending %.0f ns/frame\n", Channels::totalSize, outputRate, blend);
+  printf("  %-10s %6s %9s %9s %14s %13s\n", "pattern", "opt in", "keyframes", "render ns", "rendered us/s", "blended us/s");
+  for (byte p = 0; p < patternList.getCount(); p++) {
+    Pattern *pattern = patternItems[p];
+    double render = renderNanos(pattern);
+    int length = pattern->getFrameLength();
+    double keyframeRate = 1000.0 / max(length, OUTPUT_FRAME_LENGTH);
+    double rendered = render * outputRate / 1000;
+    double blended = (render * keyframeRate + (keyframeRate < outputRate ? blend * outputRate : 0)) / 1000;
+    printf("  %-10s %6s %5.0f fps %9.0f %14.0f %13.0f\n", patternNames[p], pattern->isInterpolated() ? "yes" : "no",
+      1000.0 / length, render, rendered, blended);
+  }
+}
+
+/**
+ * Store a program in VmPattern's live slot and load it
+ */
+void loadVm(byte mode, const byte *code, byte length)
+{
+  uint16_t address = VmPattern::slotAddress(true);
+  EEPROM.update(address, VM_MAGIC);
+  EEPROM.update(address + 1, mode);
+  EEPROM.update(address + 2, length);
+  for (byte i = 0; i < length; i++) {
+    EEPROM.update(address + VM_HEADER_SIZE + i, code[i]);
+  }
+  vmPattern->setup();
+}
+
+/**
+ * VmPattern running programs equivalent to native patterns (user-038)
+ */
+void benchVm()
+{
+  // index push8 30 mul time sub sin8 push8 200 scale8 push8 255 palette
+  const byte plasma[] = {
+    VM_INDEX, VM_PUSH8, 30, VM_MUL, VM_TIME, VM_SUB, VM_SIN8,
+    VM_PUSH8, 200, VM_SCALE8, VM_PUSH8, 255, VM_PALETTE
+  };
+  // push8 20 fade, bpm push8 8 div push8 0 count push8 1 sub beatsin16 at, push8 0 push8 255 push8 192 hsv
+  const byte sinelon[] = {
+    VM_PUSH8, 20, VM_FADE,
+    VM_BPM, VM_PUSH8, 8, VM_DIV, VM_PUSH8, 0, VM_COUNT, VM_PUSH8, 1, VM_SUB, VM_BEATSIN16, VM_AT,
+    VM_PUSH8, 0, VM_PUSH8, 255, VM_PUSH8, 192, VM_HSV
+  };
+
+  printf("VmPattern against native patterns, %d LEDs\n", Channels::totalSize);
+  double native = renderNanos(patternItems[2]);
+  loadVm(VM_MODE_PIXEL, plasma, sizeof(plasma));
+  double vm = renderNanos(vmPattern);
+  printf("  %-24s native %6.0f ns/frame, VM %6.0f ns/frame, %4.1fx\n", "Plasma (pixel mode)", native, vm, vm / native);
+
+  native = renderNanos(patternItems[4]);
+  loadVm(VM_MODE_FRAME, sinelon, sizeof(sinelon));
+  vm = renderNanos(vmPattern);
+  printf("  %-24s native %6.0f ns/frame, VM %6.0f ns/frame, %4.1fx\n", "Sinelon (frame mode)", native, vm, vm / native);
+
+  // Leave the VM blank for the other sections
+  EEPROM.update(VmPattern::slotAddress(true), 0xFF);
+  vmPattern->setup();
+}
+
+/**
+ * FastLED's random8(), an LCG on a 16 bit seed
+ */
+uint16_t benchRand16Seed = 1337;
+
+uint8_t fastledRandom8(uint8_t limit)
+{
+  benchRand16Seed = benchRand16Seed * 2053 + 13849;
+  return ((uint8_t)((benchRand16Seed & 0xFF) + (benchRand16Seed >> 8)) * limit) >> 8;
+}
+
+/**
+ * Checksum of the strobe frames Bpm draws while dropping, starting from a seed
+ */
+uint32_t strobeFrames(uint16_t seed, int frames)
+{
+  Pattern *bpm = patternItems[0];
+  fastRandom.seed(seed);
+  uint32_t sum = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    prepareFrame(bpm, true, systemClock.millis());
+    bpm->setBeatProgress(0.1); // strobing
+    bpm->loop(0, ALL_STATES);
+    for (byte s = 0; s < NUM_STATES; s++) {
+      PatternState *state = channels.getState(s);
+      for (uint16_t i = 0; i < state->ledsSize; i++) {
+        sum = sum * 31 + (state->leds[i] ? i + 1 : 0);
+      }
+    }
+  }
+  return sum;
+}
+
+/**
+ * FastRandom's bulk masks against a random8() per LED, and whether a seed replays (user-043)
+ */
+void benchRandom()
+{
+  static CRGB leds[BENCH_LEDS];
+  uint32_t lit = 0, decided = 0;
+  double perLed = nanosPer(BENCH_LEDS, [&]() {
+    for (uint16_t i = 0; i < BENCH_LEDS; i++) {
+      leds[i] = fastledRandom8(3) == 0 ? CRGB::White : CRGB::Black;
+    }
+    sink(leds, 1);
+  });
+  double masked = nanosPer(BENCH_LEDS, [&]() {
+    uint16_t bits = 0;
+    for (uint16_t i = 0; i < BENCH_LEDS; i++) {
+      if ((i & 15) == 0) {
+        bits = fastRandom.mask(85);
+      }
+      leds[i] = (bits & 1) ? CRGB::White : CRGB::Black;
+      bits >>= 1;
+    }
+    sink(leds, 1);
+  });
+  for (int i = 0; i < 1000; i++) {
+    lit += __builtin_popcount(fastRandom.mask(85));
+    decided += 16;
+  }
+  printf("Strobe, one in three of %d LEDs lit\n", BENCH_LEDS);
+  printf("  random8(3) per LED        %6.2f ns/LED\n", perLed);
+  printf("  FastRandom::mask(85)      %6.2f ns/LED, %4.1fx faster, %.1f%% lit\n", masked, perLed / masked, 100.0 * lit / decided);
+
+  const int count = 1000;
+  uint16_t values[count];
+  fastRandom.seed(0x1234);
+  for (int i = 0; i < count; i++) {
+    values[i] = fastRandom.next();
+  }
+  fastRandom.seed(0x1234);
+  bool replayed = true;
+  for (int i = 0; i < count; i++) {
+    replayed = replayed && fastRandom.next() == values[i];
+  }
+  uint32_t strobe = strobeFrames(0x1234, 50);
+  replayed = replayed && strobeFrames(0x1234, 50) == strobe;
+  bool differs = strobeFrames(0x4321, 50) != strobe;
+  if (!replayed || !differs) {
+    failures++;
+  }
+  printf("%s seed 0x1234 %s the same %d values and 50 strobe frames, seed 0x4321 %s\n",
+    replayed && differs ? "ok  " : "FAIL", replayed ? "replays" : "doesn't replay", count, differs ? "differs" : "draws the same");
+}
+
+/**
+ * PostProcess::apply() per effect, on a frame with a few dots (user-047)
+ */
+void benchPostProcess()
+{
+  static CRGB frame[BENCH_LEDS], leds[BENCH_LEDS];
+  static byte active[(BENCH_LEDS + 7) / 8];
+  PatternState state(BENCH_LEDS, leds, active);
+  memset((byte *)frame, 0, sizeof(frame));
+  for (uint16_t i = 0; i < BENCH_LEDS; i += 15) {
+    frame[i] = CHSV(i, 200, 255);
+  }
+
+  // Every run starts from the same frame, the copy is taken back out below
+  double restore = nanosPer(BENCH_LEDS, [&]() {
+    memcpy(leds, frame, sizeof(frame));
+    sink(leds, 1);
+  });
+  double fade = nanosPer(BENCH_LEDS, [&]() {
+    memcpy(leds, frame, sizeof(frame));
+    fadeToBlackBy(leds, BENCH_LEDS, 20);
+    sink(leds, 1);
+  }) - restore;
+
+  printf("Post-processing, %d LEDs with a dot every 15\n", BENCH_LEDS);
+  printf("  %-24s %6.2f ns/LED %6.2fx\n", "fadeToBlackBy()", fade, 1.0);
+  struct {
+    const char *name;
+    fract8 blur, bloom, trail;
+  } effects[] = {
+    {"blur 64", 64, 0, 0},
+    {"bloom 64", 0, 64, 0},
+    {"trail 192", 0, 0, 192},
+    {"blur, bloom and trail", 64, 64, 192},
+  };
+  for (auto &effect : effects) {
+    double nanos = nanosPer(BENCH_LEDS, [&]() {
+      memcpy(leds, frame, sizeof(frame));
+      PostProcess::apply(&state, effect.blur, effect.bloom, effect.trail);
+      sink(leds, 1);
+    }) - restore;
+    printf("  %-24s %6.2f ns/LED %6.2fx\n", effect.name, nanos, nanos / fade);
+  }
+}
+
+/**
+ * Every pattern at its own frame rate, and Fire's heat kernel on longer strips (user-050)
+ */
+void benchPatterns()
+{
+  printf("Patterns, %d LEDs at their own frame rate\n", Channels::totalSize);
+  printf("  %-10s %5s %9s %8s %7s\n", "pattern", "fps", "ns/frame", "ns/LED", "us/s");
+  for (byte p = 0; p < patternList.getCount(); p++) {
+    Pattern *pattern = patternItems[p];
+    double render = renderNanos(pattern);
+    double fps = 1000.0 / pattern->getFrameLength();
+    printf("  %-10s %5.0f %9.0f %8.2f %7.0f\n", patternNames[p], fps, render, render / Channels::totalSize, render * fps / 1000);
+  }
+
+  printf("Fire on a single strip\n");
+  uint16_t sizes[] = {60, 120, 240, 480};
+  Pattern *fire = patternItems[7];
+  for (uint16_t size : sizes) {
+    CRGB *leds = new CRGB[size];
+    byte *active = new byte[(size + 7) / 8];
+    byte *heat = new byte[size];
+    memset(heat, 0, size);
+    PatternState state(size, leds, active, heat);
+    state.palette = channels.getState(0)->palette;
+    double nanos = nanosPer(size, [&]() {
+      fire->loopForState(&state, 0);
+      sink(leds, 1);
+    });
+    printf("  %4d LEDs %8.2f ns/LED %8.0f ns/frame\n", size, nanos, nanos * size);
+    delete[] leds;
+    delete[] active;
+    delete[] heat;
+  }
+}
+
+struct Section {
+  const char *name;
+  void (*run)();
+} sections[] = {
+  {"output", benchOutput},
+  {"active", benchActive},
+  {"interpolation", benchInterpolation},
+  {"vm", benchVm},
+  {"random", benchRandom},
+  {"postprocess", benchPostProcess},
+  {"patterns", benchPatterns},
+};
+
+int main(int argc, char **argv)
+{
+  setup();
+  for (const Section &section : sections) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; i++) {
+      selected = selected || !strcmp(argv[i], section.name);
+    }
+    if (selected) {
+      section.run();
+    }
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * Measures how far millis() and the Timer1 corrected Clock drift from real time
+ * on the Nano, while FastLED.show() keeps interrupts off. Run with run.sh clock.
+ *
+ * Simulates the ATmega328 at 16MHz: Timer0 overflows every 1024us and its interrupt
+ * advances millis() (by 1, plus 1 every 125/3 overflows), but while interrupts are off
+ * only one overflow stays pending, the rest are lost. Timer1 counts every 16us regardless.
+ * Clock.h is built for the AVR against these, so update() runs the code the Nano runs.
+ *
+ * Reports the drift after an hour for a few strip lengths and frame rates, as time and in
+ * beats at 128 bpm. Fails when the corrected clock is ever off by more than CLOCK_MAX_DRIFT_MILLIS.
+ *
+ * Usage: clock [minutes]
+ */
+#include <Host.h>
+
+// Timer1, as Clock.h sees it on the Nano
+uint16_t TCNT1;
+uint8_t TCCR1A;
+uint8_t TCCR1B;
+#define _BV(bit) (1 << (bit))
+#define CS12 2
+
+#define __AVR__
+#include <Clock.h>
+
+#define TIMER0_OVERFLOW_MICROS 1024 // 256 * 64 / 16MHz
+#define CLOCK_BEAT_MILLIS 469 // 128 bpm
+#define CLOCK_MAX_DRIFT_MILLIS 2
+
+/**
+ * The AVR's timers, against real time
+ */
+struct Nano {
+  uint64_t micros = 0; // real time
+  uint64_t nextOverflow = TIMER0_OVERFLOW_MICROS;
+  uint32_t timer0Millis = 0;
+  byte timer0Fract = 0;
+  bool overflowPending = false;
+
+  Nano()
+  {
+    soakMicros = 0;
+    TCNT1 = 0;
+  }
+
+  /**
+   * Timer0 overflow interrupt, as in the Arduino core's wiring.c
+   */
+  void overflow()
+  {
+    timer0Millis++;
+    timer0Fract += 3;
+    if (timer0Fract >= 125) {
+      timer0Fract -= 125;
+      timer0Millis++;
+    }
+    soakMicros = (uint64_t)timer0Millis * 1000; // what millis() returns
+  }
+
+  /**
+   * Let time pass
+   * @param interrupts Whether interrupts are enabled meanwhile
+   */
+  void run(uint32_t duration, bool interrupts)
+  {
+    micros += duration;
+    while (nextOverflow <= micros) {
+      if (interrupts) {
+        overflow();
+      } else {
+        overflowPending = true; // a single flag, further overflows are lost
+      }
+      nextOverflow += TIMER0_OVERFLOW_MICROS;
+    }
+    if (interrupts && overflowPending) {
+      overflow();
+      overflowPending = false;
+    }
+    TCNT1 = micros / CLOCK_TICK_MICROS;
+  }
+};
+
+struct Drift {
+  int32_t raw; // millis(), at the end
+  int32_t corrected; // Clock, at the end
+  int32_t worst; // Clock, furthest off at any point
+};
+
+/**
+ * Loop like main.cpp: update the clock, render, and transmit when a frame is due
+ * @param frameMicros 0 to transmit every loop, as fast as possible
+ */
+Drift run(uint32_t minutes, uint16_t leds, uint32_t frameMicros)
+{
+  Nano nano;
+  Clock clock;
+  clock.setup();
+  Drift drift = {0, 0, 0};
+  uint64_t duration = (uint64_t)minutes * 60000000;
+  uint64_t nextFrame = 0;
+
+  while (nano.micros < duration) {
+    uint32_t ms = clock.update();
+    int32_t off = (int32_t)(ms - nano.micros / 1000);
+    if (abs(off) > abs(drift.worst)) {
+      drift.worst = off;
+    }
+
+    nano.run(random(2000, 6000), true); // render
+    if (nano.micros >= nextFrame) {
+      nextFrame = nano.micros + frameMicros;
+      nano.run(leds * TRANSMIT_MICROS_PER_LED, false);
+      nano.run(0, true);
+    }
+  }
+
+  clock.update();
+  drift.raw = (int32_t)(millis() - nano.micros / 1000);
+  drift.corrected = (int32_t)(clock.millis() - nano.micros / 1000);
+  return drift;
+}
+
+int failures = 0;
+
+void check(uint32_t minutes, uint16_t leds, uint32_t fps)
+{
+  Drift drift = run(minutes, leds, fps ? 1000000 / fps : 0);
+  bool ok = abs(drift.worst) <= CLOCK_MAX_DRIFT_MILLIS;
+  if (!ok) {
+    failures++;
+  }
+  char rate[12] = "max";
+  if (fps) {
+    snprintf(rate, sizeof(rate), "%u", fps);
+  }
+  printf("%s %4u %4s %9d %7.1f %9d %7.2f %6d\n", ok ? "ok  " : "FAIL", leds, rate,
+    drift.raw, (float)drift.raw / CLOCK_BEAT_MILLIS,
+    drift.corrected, (float)drift.corrected / CLOCK_BEAT_MILLIS, drift.worst);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t minutes = argc > 1 ? atoi(argv[1]) : 60;
+  srand(1);
+
+  printf("Drift from real time after %u minutes, in ms and beats at 128 bpm\n", minutes);
+  printf("     LEDs  fps millis() beats     Clock   beats  worst\n");
+  check(minutes, 29, 30);
+  check(minutes, 149, 30);
+  check(minutes, 149, 60);
+  check(minutes, 149, 0);
+  check(minutes, 300, 30);
+  check(minutes, 600, 0);
+  printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * Feeds accelerometer traces through GestureControl, into ModeControl and DropControl
+ * as main.cpp does, and counts what comes out. Run with run.sh gestures.
+ *
+ * Built-in traces are synthesised from a simple model of an ADXL335 on the scarf
+ * (512 counts at 0g, ADC_COUNTS_PER_G per g, saturating at ADC_RANGE_G, gravity on z): standing still, walking and
+ * dancing, where nothing should trigger, and repeated double shakes (with peaks up to
+ * 580ms apart), tilts and jumps, each of which should trigger exactly once.
+ * Fails when any of them doesn't, or when dancing triggers more than
+ * GESTURE_MAX_DANCE_TRIGGERS per 10 minutes.
+ *
+ * Recorded traces (GESTURE_TRACE in main.cpp, "x,y,z" per line, other lines skipped)
+ * can be passed as arguments, and are reported without pass or fail.
+ * Also reports the CPU time GestureControl::update() takes per sample,
+ * build with SOAK_SANITIZE=0 for a meaningful figure.
+ *
+ * Usage: gestures [trace.csv...]
+ */
+#include <chrono>
+#include <Host.h>
+#include <GestureControl.h>
+#include <ModeControl.h>
+#include <DropControl.h>
+
+#define ADC_CENTER 512
+#define ADC_COUNTS_PER_G 70
+#define ADC_RANGE_G 3.6 // the ADXL335 saturates beyond that
+#define MODE_PIN 6
+#define DROP_PIN 7
+#define GESTURE_MAX_DANCE_TRIGGERS 2
+
+struct Sample {
+  int x, y, z;
+};
+
+typedef std::vector<Sample> Trace;
+
+/**
+ * Add a sample, in counts from 0g, as the ADC would read it
+ */
+void add(Trace &trace, int x, int y, int z)
+{
+  int limit = ADC_RANGE_G * ADC_COUNTS_PER_G;
+  trace.push_back({
+    ADC_CENTER + constrain(x, -limit, limit),
+    ADC_CENTER + constrain(y, -limit, limit),
+    ADC_CENTER + constrain(z, -limit, limit)
+  });
+}
+
+struct Triggers {
+  int patterns = 0; // short mode presses
+  int palettes = 0; // long mode presses
+  int drops = 0;
+  int dropMillis = 0; // longest drop held
+};
+
+uint64_t updateNanos = 0;
+uint32_t updates = 0;
+
+/**
+ * Replay a trace at GESTURE_SAMPLE_MILLIS, as main.cpp's loop() would
+ */
+Triggers replay(const Trace &trace)
+{
+  GestureControl gestures(MODE_PIN, DROP_PIN);
+  ModeControl modeControl(MODE_PIN);
+  DropControl dropControl(DROP_PIN);
+  Triggers triggers;
+  uint32_t dropFellMillis = 0;
+
+  for (const Sample &sample : trace) {
+    uint32_t ms = systemClock.update();
+    modeControl.update();
+    dropControl.update();
+
+    auto start = std::chrono::steady_clock::now();
+    gestures.update(sample.x, sample.y, sample.z, ms);
+    updateNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    updates++;
+
+    ButtonEvent event;
+    while (gestures.pop(event)) {
+      modeControl.handle(event);
+      dropControl.handle(event);
+      if (event.pin == DROP_PIN && event.pressed) {
+        dropFellMillis = event.millis;
+      } else if (event.pin == DROP_PIN) {
+        triggers.dropMillis = max(triggers.dropMillis, (int)(event.millis - dropFellMillis));
+      }
+    }
+    if (modeControl.rose()) {
+      if (modeControl.wasLongPress()) {
+        triggers.palettes++;
+      } else {
+        triggers.patterns++;
+      }
+    }
+    if (dropControl.fell()) {
+      triggers.drops++;
+    }
+    soakMicros += GESTURE_SAMPLE_MILLIS * 1000;
+  }
+  return triggers;
+}
+
+/**
+ * Sensor noise, up to amplitude counts either way
+ */
+int noise(int amplitude)
+{
+  return random(-amplitude, amplitude + 1);
+}
+
+/**
+ * Add samples at rest, with gravity on z
+ */
+void rest(Trace &trace, uint32_t ms)
+{
+  for (uint32_t t = 0; t < ms; t += GESTURE_SAMPLE_MILLIS) {
+    add(trace, noise(3), noise(3), ADC_COUNTS_PER_G + noise(3));
+  }
+}
+
+/**
+ * Add samples of a periodic bounce on z with sway on x and y, e.g. walking or dancing
+ * @param bounce Vertical amplitude in g
+ * @param sway Sideways amplitude in g
+ */
+void move(Trace &trace, uint32_t ms, float hertz, float bounce, float sway, int noiseCounts)
+{
+  for (uint32_t t = 0; t < ms; t += GESTURE_SAMPLE_MILLIS) {
+    float phase = 2 * M_PI * hertz * t / 1000;
+    add(trace,
+      sway * ADC_COUNTS_PER_G * sin(phase / 2) + noise(noiseCounts),
+      sway * ADC_COUNTS_PER_G * cos(phase / 2) + noise(noiseCounts),
+      ADC_COUNTS_PER_G + bounce * ADC_COUNTS_PER_G * sin(phase) + noise(noiseCounts)
+    );
+  }
+}
+
+/**
+ * Add a sharp peak of motion on x, over three samples
+ */
+void peak(Trace &trace, float g)
+{
+  int counts = g * ADC_COUNTS_PER_G;
+  add(trace, counts, 0, ADC_COUNTS_PER_G);
+  add(trace, -counts * 2 / 3, 0, ADC_COUNTS_PER_G);
+  add(trace, counts / 3, 0, ADC_COUNTS_PER_G);
+}
+
+Trace doubleShakes(int repeats)
+{
+  Trace trace;
+  for (int i = 0; i < repeats; i++) {
+    rest(trace, 3000);
+    peak(trace, 3);
+    rest(trace, 200 + i * 380 / (repeats - 1) - 3 * GESTURE_SAMPLE_MILLIS); // 200 to 580ms apart
+    peak(trace, 3);
+  }
+  rest(trace, 3000);
+  return trace;
+}
+
+Trace tilts(int repeats)
+{
+  Trace trace;
+  for (int i = 0; i < repeats; i++) {
+    rest(trace, 4000);
+    // Leaning over by about 60 degrees, so gravity shifts from z to x
+    for (uint32_t t = 0; t < 2500; t += GESTURE_SAMPLE_MILLIS) {
+      add(trace, ADC_COUNTS_PER_G * 87 / 100 + noise(3), noise(3), ADC_COUNTS_PER_G / 2 + noise(3));
+    }
+  }
+  rest(trace, 4000);
+  return trace;
+}
+
+Trace jumps(int repeats)
+{
+  Trace trace;
+  for (int i = 0; i < repeats; i++) {
+    rest(trace, 4000);
+    // Landing jolts all axes, beyond what the sensor can read on z
+    add(trace, ADC_COUNTS_PER_G * 2, -ADC_COUNTS_PER_G * 2, ADC_COUNTS_PER_G * 5);
+    add(trace, -ADC_COUNTS_PER_G, ADC_COUNTS_PER_G, -ADC_COUNTS_PER_G);
+    add(trace, 0, 0, ADC_COUNTS_PER_G * 2);
+  }
+  rest(trace, 4000);
+  return trace;
+}
+
+Trace load(const char *path)
+{
+  Trace trace;
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    printf("FAIL can't read %s\n", path);
+    exit(1);
+  }
+  char line[64];
+  while (fgets(line, sizeof(line), file)) {
+    Sample sample;
+    if (sscanf(line, "%d,%d,%d", &sample.x, &sample.y, &sample.z) == 3) {
+      trace.push_back(sample);
+    }
+  }
+  fclose(file);
+  return trace;
+}
+
+int failures = 0;
+
+void check(const char *name, const Trace &trace, int patterns, int palettes, int drops, int maxTriggers = 0)
+{
+  Triggers t = replay(trace);
+  float minutes = trace.size() * GESTURE_SAMPLE_MILLIS / 60000.0;
+  bool ok = maxTriggers
+    ? t.patterns + t.palettes + t.drops <= maxTriggers
+    : t.patterns == patterns && t.palettes == palettes && t.drops == drops;
+  if (!ok) {
+    failures++;
+  }
+  printf("%s %-14s %5.1f min: %3d patterns, %3d palettes, %3d drops (longest %dms)\n",
+    ok ? "ok  " : "FAIL", name, minutes, t.patterns, t.palettes, t.drops, t.dropMillis);
+}
+
+int main(int argc, char **argv)
+{
+  srand(1);
+  soakMicros = 1000000;
+  systemClock.setup();
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      Triggers t = replay(load(argv[i]));
+      printf("%s: %d patterns, %d palettes, %d drops\n", argv[i], t.patterns, t.palettes, t.drops);
+    }
+    return 0;
+  }
+
+  Trace trace;
+  rest(trace, 600000);
+  check("standing", trace, 0, 0, 0);
+  trace.clear();
+  move(trace, 600000, 1.8, 0.3, 0.15, 4);
+  check("walking", trace, 0, 0, 0);
+  trace.clear();
+  move(trace, 600000, 2, 0.8, 0.4, 8); // bouncing at 120bpm
+  check("dancing", trace, 0, 0, 0, GESTURE_MAX_DANCE_TRIGGERS);
+  check("double shakes", doubleShakes(20), 20, 0, 0);
+  check("tilts", tilts(10), 0, 10, 0);
+  check("jumps", jumps(10), 0, 0, 10);
+
+  printf("GestureControl::update(): %.0fns per sample on this machine\n", (double)updateNanos / updates);
+  printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+/**
+ * Runs the threaded OutputPipeline against real time, with the channels from main.cpp.
+ * Run with run.sh pipeline.
+ *
+ * Each frame fills every LED with its frame number, a few LEDs at a time over
+ * PIPELINE_RENDER_MICROS, while the previous frame goes out. Transmission sleeps
+ * TRANSMIT_MICROS_PER_LED per LED, as FastLED would be busy on the Nano.
+ * Fails when a strip goes out torn (LEDs from different frames), when a frame is skipped
+ * or sent twice, or when pipelining doesn't gain PIPELINE_MIN_SPEEDUP over
+ * rendering and transmitting one after the other (present() then flush()).
+ *
+ * Usage: pipeline [frames]
+ */
+#define OUTPUT_PIPELINE_THREADED
+#include <chrono>
+#include <thread>
+#include <Host.h>
+#include <ChannelList.h>
+#include <OutputPipeline.h>
+
+#define PIPELINE_RENDER_MICROS 4000
+#define PIPELINE_RENDER_STEPS 8 // sleeps while rendering, so a torn copy would show
+#define PIPELINE_MIN_SPEEDUP 1.3
+
+typedef ChannelList<
+  Channel<4, 120>, // scarf
+  Channel<2, 29> // hat
+> Channels;
+
+Channels channels;
+
+uint16_t transmittedFrame[MAX_CONTROLLERS];
+uint32_t torn = 0;
+uint32_t outOfOrder = 0;
+
+uint16_t frameOf(const CRGB &led)
+{
+  return led.r | led.g << 8;
+}
+
+/**
+ * Called by the worker thread for each strip, checks it holds the next frame
+ * throughout transmission
+ */
+void transmit(const CLEDController &controller)
+{
+  uint8_t index = &controller - FastLED.controllers;
+  uint16_t frame = frameOf(controller.leds[0]);
+  if (frame != (uint16_t)(transmittedFrame[index] + 1)) {
+    outOfOrder++;
+  }
+  transmittedFrame[index] = frame;
+  std::this_thread::sleep_for(std::chrono::microseconds(controller.count * TRANSMIT_MICROS_PER_LED));
+  for (uint16_t i = 0; i < controller.count; i++) {
+    if (frameOf(controller.leds[i]) != frame) {
+      torn++;
+      break;
+    }
+  }
+}
+
+void render(uint16_t frame)
+{
+  CRGB color(frame & 0xFF, frame >> 8, 0);
+  for (uint8_t step = 0; step < PIPELINE_RENDER_STEPS; step++) {
+    for (uint8_t state = 0; state < Channels::count; state++) {
+      PatternState *s = channels.getState(state);
+      for (uint16_t i = step; i < s->ledsSize; i += PIPELINE_RENDER_STEPS) {
+        s->leds[i] = color;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(PIPELINE_RENDER_MICROS / PIPELINE_RENDER_STEPS));
+  }
+}
+
+/**
+ * Render and present frames, returning the frame rate
+ * @param serial Wait for each frame to go out before rendering the next
+ */
+double run(uint16_t frames, bool serial)
+{
+  memset(transmittedFrame, 0, sizeof(transmittedFrame));
+  uint32_t shows = FastLED.shows;
+  auto start = std::chrono::steady_clock::now();
+  {
+    OutputPipeline<Channels> output(channels);
+    output.setup();
+    for (uint16_t frame = 1; frame <= frames; frame++) {
+      render(frame);
+      output.present(255, 255, Channels::all);
+      if (serial) {
+        output.flush();
+      }
+    }
+    // the destructor sends the last frame and stops the worker
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (uint8_t i = 0; i < FastLED.numControllers; i++) {
+    if (transmittedFrame[i] != frames) {
+      outOfOrder++;
+    }
+  }
+  if (FastLED.shows - shows != frames) {
+    outOfOrder++;
+  }
+  return frames / seconds;
+}
+
+int main(int argc, char **argv)
+{
+  uint16_t frames = argc > 1 ? atoi(argv[1]) : 200;
+  channels.setup();
+  FastLED.onTransmit = transmit;
+
+  double serialFps = run(frames, true);
+  double pipelinedFps = run(frames, false);
+  double speedup = pipelinedFps / serialFps;
+  bool ok = !torn && !outOfOrder && speedup >= PIPELINE_MIN_SPEEDUP;
+
+  printf("%d LEDs at %dus each, %dus to render\n", Channels::totalSize, TRANSMIT_MICROS_PER_LED, PIPELINE_RENDER_MICROS);
+  printf("serial    %6.1f fps\n", serialFps);
+  printf("pipelined %6.1f fps (%.2fx)\n", pipelinedFps, speedup);
+  printf("%s %d frames twice: %u torn strips, %u skipped or repeated\n", ok ? "ok  " : "FAIL", frames, torn, outOfOrder);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,274 @@
+/**
+ * Talks to main.cpp through RemoteControl over a serial loopback, framing commands
+ * as scripts/remote.py does. Run with run.sh remote.
+ *
+ * Checks that every command gets through to the controls it drives, that pings of
+ * every payload length come back unchanged, that frames with a bad checksum or
+ * an oversized payload are ignored without losing the next one, and that a VmPattern
+ * upload lands in EEPROM. Then sends REMOTE_NOISE_PINGS pings, each after up to
+ * REMOTE_NOISE_BYTES random bytes, or after a frame cut off, and reports how many got
+ * answered, and how many commands the noise made up. Fails when fewer than
+ * REMOTE_MIN_NOISE_ANSWERED percent are answered, or noise gets a command through.
+ * A frame right after a cut off one is mostly lost, that's only reported.
+ *
+ * Usage: remote [seed]
+ */
+#include <Host.h>
+#include <main.cpp>
+
+#define REMOTE_NOISE_PINGS 2000
+#define REMOTE_NOISE_BYTES 20
+#define REMOTE_MIN_NOISE_ANSWERED 90
+
+typedef std::vector<byte> Bytes;
+
+struct Reply {
+  byte command;
+  Bytes payload;
+};
+
+int failures = 0;
+
+void check(const char *name, bool ok)
+{
+  if (!ok) {
+    failures++;
+  }
+  printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+}
+
+/**
+ * A command as scripts/remote.py frames it
+ */
+Bytes frame(byte command, const Bytes &payload = Bytes())
+{
+  Bytes bytes = {REMOTE_START_1, REMOTE_START_2, command, (byte)payload.size()};
+  byte checksum = command ^ payload.size();
+  for (byte b : payload) {
+    bytes.push_back(b);
+    checksum ^= b;
+  }
+  bytes.push_back(checksum);
+  return bytes;
+}
+
+/**
+ * Let the firmware run for a while, reading serial once per loop
+ */
+void run(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i++) {
+    soakMicros += 1000;
+    loop();
+  }
+}
+
+/**
+ * Replies sent since the last call, skipping anything else on serial
+ */
+std::vector<Reply> replies()
+{
+  RemoteControl parser; // same framing both ways
+  std::vector<Reply> result;
+  for (byte b : Serial.output) {
+    if (parser.receive(b, 0) && (parser.getCommand() & REMOTE_REPLY)) {
+      byte *payload = parser.getPayload();
+      result.push_back({(byte)(parser.getCommand() & ~REMOTE_REPLY), Bytes(payload, payload + parser.getLength())});
+    }
+  }
+  Serial.output.clear();
+  return result;
+}
+
+/**
+ * Send a command and wait for its reply
+ * @return The reply's payload, empty when there was none
+ */
+Bytes request(byte command, const Bytes &payload = Bytes())
+{
+  replies();
+  Bytes bytes = frame(command, payload);
+  Serial.input.insert(Serial.input.end(), bytes.begin(), bytes.end());
+  run(20);
+  for (const Reply &reply : replies()) {
+    if (reply.command == command) {
+      return reply.payload;
+    }
+  }
+  return Bytes();
+}
+
+/**
+ * Send a command which doesn't reply, and give it a bar to take effect on the beat
+ */
+void command(byte command, const Bytes &payload)
+{
+  Bytes bytes = frame(command, payload);
+  Serial.input.insert(Serial.input.end(), bytes.begin(), bytes.end());
+  run(beatControl.getBeatLength() * 4);
+}
+
+/**
+ * REMOTE_QUERY_STATS, asking again when the reply got lost (e.g. to a cut off frame before).
+ * All 0xFF when there's no answer, which no check expects.
+ */
+Bytes stats()
+{
+  for (byte attempt = 0; attempt < 3; attempt++) {
+    Bytes reply = request(REMOTE_QUERY_STATS);
+    if (reply.size() == 14) {
+      return reply;
+    }
+  }
+  return Bytes(14, 0xFF);
+}
+
+/**
+ * Upload a program through REMOTE_VM_*, sending chunks again while the EEPROM is busy
+ */
+bool upload(byte mode, const Bytes &code)
+{
+  byte checksum = mode ^ code.size();
+  for (byte b : code) {
+    checksum ^= b;
+  }
+  Bytes status = request(REMOTE_VM_BEGIN, {mode, (byte)code.size()});
+  if (status != Bytes{VM_UPLOAD_OK}) {
+    return false;
+  }
+  for (byte offset = 0; offset < code.size(); offset += VM_CHUNK_SIZE) {
+    Bytes chunk = {offset};
+    chunk.insert(chunk.end(), code.begin() + offset, code.begin() + min(code.size(), offset + VM_CHUNK_SIZE));
+    do {
+      status = request(REMOTE_VM_DATA, chunk);
+    } while (status == Bytes{VM_UPLOAD_BUSY});
+    if (status != Bytes{VM_UPLOAD_OK}) {
+      return false;
+    }
+  }
+  do {
+    status = request(REMOTE_VM_COMMIT, {checksum});
+  } while (status == Bytes{VM_UPLOAD_BUSY});
+  run(20); // header and slot get written after the reply
+  return status == Bytes{VM_UPLOAD_OK};
+}
+
+/**
+ * Ping through noise, e.g. a loose connector or another device talking on the line
+ * @param cutOff Whether the noise holds the start of frames (pings, so made up ones show)
+ * @param gapMillis Between the noise and the ping
+ * @param judged Whether to fail on lost pings or made up commands, or only report them
+ */
+void noise(const char *name, bool cutOff, uint32_t gapMillis, bool judged)
+{
+  uint32_t answered = 0;
+  uint32_t madeUp = 0;
+  byte pattern = stats()[0];
+  for (uint32_t i = 0; i < REMOTE_NOISE_PINGS; i++) {
+    Bytes noise;
+    if (cutOff) {
+      Bytes payload(random(REMOTE_MAX_PAYLOAD + 1));
+      for (byte &b : payload) {
+        b = random(256);
+      }
+      noise = frame(REMOTE_PING, payload);
+      noise.resize(random(2, noise.size()));
+    } else {
+      noise.resize(random(REMOTE_NOISE_BYTES + 1));
+      for (byte &b : noise) {
+        b = random(256);
+      }
+    }
+    Bytes payload = {(byte)i, (byte)(i >> 8)};
+    Bytes bytes = frame(REMOTE_PING, payload);
+    Serial.input.insert(Serial.input.end(), noise.begin(), noise.end());
+    run(gapMillis);
+    Serial.input.insert(Serial.input.end(), bytes.begin(), bytes.end());
+    run(20);
+    for (const Reply &reply : replies()) {
+      if (reply.command == REMOTE_PING && reply.payload == payload) {
+        answered++;
+      } else {
+        madeUp++;
+      }
+    }
+  }
+  run(beatControl.getBeatLength() * 4);
+  madeUp += stats()[0] != pattern;
+  float percent = 100.0 * answered / REMOTE_NOISE_PINGS;
+  printf("     %-40s %4u of %u pings answered (%5.1f%%), %u made up commands\n", name, answered, REMOTE_NOISE_PINGS, percent, madeUp);
+  if (judged) {
+    check("  loses few pings", percent >= REMOTE_MIN_NOISE_ANSWERED);
+    check("  makes up no commands", !madeUp);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  srand(argc > 1 ? atoi(argv[1]) : 1);
+  memset(soakPins, HIGH, sizeof(soakPins));
+  soakMicros = 1000000;
+  setup();
+  run(100);
+
+  bool echoed = true;
+  for (byte length = 0; length <= REMOTE_MAX_PAYLOAD; length++) {
+    Bytes payload;
+    for (byte i = 0; i < length; i++) {
+      payload.push_back(random(256));
+    }
+    // An empty reply can't tell a missing one from an echo of nothing, so look for it
+    replies();
+    Bytes bytes = frame(REMOTE_PING, payload);
+    Serial.input.insert(Serial.input.end(), bytes.begin(), bytes.end());
+    run(20);
+    std::vector<Reply> got = replies();
+    echoed = echoed && got.size() == 1 && got[0].command == REMOTE_PING && got[0].payload == payload;
+  }
+  check("pings of 0 to 16 bytes come back unchanged", echoed);
+
+  Bytes bad = frame(REMOTE_PING, {1, 2, 3});
+  bad.back() ^= 0x10;
+  Serial.input.insert(Serial.input.end(), bad.begin(), bad.end());
+  run(20);
+  check("a bad checksum gets no reply", replies().empty());
+
+  Bytes oversized = {REMOTE_START_1, REMOTE_START_2, REMOTE_PING, REMOTE_MAX_PAYLOAD + 1};
+  Serial.input.insert(Serial.input.end(), oversized.begin(), oversized.end());
+  check("an oversized payload is dropped, and the next frame gets through", request(REMOTE_PING, {42}) == Bytes{42});
+
+  command(REMOTE_SET_PATTERN, {2});
+  check("SET_PATTERN switches on the beat", stats()[0] == 2);
+  command(REMOTE_SET_PALETTE, {1});
+  check("SET_PALETTE switches on the beat", stats()[1] == 1);
+  command(REMOTE_SET_BRIGHTNESS, {1});
+  check("SET_BRIGHTNESS sets the level", stats()[2] == 1);
+  command(REMOTE_SET_BEAT, {400 & 0xFF, 400 >> 8, 0xFF, 0xFF});
+  Bytes s = stats();
+  check("SET_BEAT sets the tempo", s.size() == 14 && (s[4] | s[5] << 8) == 400);
+  command(REMOTE_DROP, {1});
+  bool dropped = stats()[3] & 1;
+  command(REMOTE_DROP, {0});
+  check("DROP starts and stops a drop", dropped && !(stats()[3] & 1));
+
+  // (push8 0 pop) x 7, push8 0 push8 255 push8 255 hsv: a red frame, in more than one chunk
+  Bytes code;
+  for (byte i = 0; i < 7; i++) {
+    code.insert(code.end(), {VM_PUSH8, 0, VM_POP});
+  }
+  code.insert(code.end(), {VM_PUSH8, 0, VM_PUSH8, 255, VM_PUSH8, 255, VM_HSV});
+  bool uploaded = upload(VM_MODE_PIXEL, code);
+  uint16_t address = VmPattern::slotAddress(true);
+  bool stored = EEPROM.read(address) == VM_MAGIC && EEPROM.read(address + 2) == code.size();
+  for (byte i = 0; i < code.size(); i++) {
+    stored = stored && EEPROM.read(address + VM_HEADER_SIZE + i) == code[i];
+  }
+  check("a VmPattern upload in two chunks lands in the active slot", uploaded && stored);
+
+  noise("random bytes", false, 0, true);
+  noise("cut off frames, next one 300ms later", true, 300, true);
+  noise("cut off frames, next one right away", true, 0, false);
+
+  printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
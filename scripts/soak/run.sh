@@ -0,0 +1,18 @@
+#!/bin/sh
+# Build one of the host programs in scripts/soak for your computer and run it.
+# Usage: [SOAK_FLAGS=-DFRAME_GOVERNOR] [SOAK_SANITIZE=0] scripts/soak/run.sh <program> [arguments]
+# e.g. run.sh gestures. Sanitizers are on unless SOAK_SANITIZE=0, which timings need.
+set -e
+cd "$(dirname "$0")/../.."
+program="$1"
+shift
+binary="${TMPDIR:-/tmp}/scarf-$program"
+sanitize="-fsanitize=address,undefined -fno-sanitize-recover=undefined"
+if [ "$SOAK_SANITIZE" = 0 ]; then
+  sanitize=""
+fi
+c++ -std=gnu++11 -O2 -g $sanitize -Wall -Wno-sign-compare $SOAK_FLAGS \
+  -Iscripts/soak/stubs -Isrc -Ilib/ArduinoTapTempo \
+  "scripts/soak/$program.cpp" lib/ArduinoTapTempo/ArduinoTapTempo.cpp \
+  -o "$binary" -lpthread
+"$binary" "$@"
@@ -0,0 +1,297 @@
+/**
+ * Soaks the firmware on the host, across a millis() wrap. Build and run with soak.sh.
+ *
+ * Runs setup() and loop() from main.cpp against simulated time. The beat gets tapped in,
+ * patterns and palettes changed, drops held, autopilot toggled and brightness stepped
+ * through the buttons, the outfit gets shaken through the accelerometer, and noise
+ * arrives on the serial line. The clock starts half the run before millis() wraps.
+ *
+ * Each loop() takes SOAK_LOOP_MICROS to twice that, plus the time FastLED.show() spends
+ * transmitting (see FastLED.h). Rendering itself takes no simulated time, so frame timing
+ * reflects the loop and its frame scheduling rather than the Nano's CPU.
+ *
+ * Checks after every loop() that nothing was written past the channel LED buffers
+ * (see CHANNEL_GUARD_BYTES), the clock didn't go back, beat progress stayed in range
+ * and frames kept coming, and after every simulated minute that the beat kept the tapped tempo.
+ *
+ * Reports per pattern: frames shown, their interval (min, mean, max and standard deviation
+ * as jitter), the share of time spent transmitting them, and the energy drawn by the LEDs,
+ * from FastLED's power model. With FRAME_GOVERNOR, also the mean brightness change
+ * per frame it measured (see GOVERNOR_STATIC_CHANGE).
+ *
+ * Usage: soak [minutes] [seed], 540 simulated minutes (9 hours) by default.
+ * Build flags (e.g. -DFRAME_GOVERNOR) go into SOAK_FLAGS, see soak.sh.
+ */
+#include <inttypes.h>
+#include <Host.h>
+
+#define CHANNEL_GUARD_BYTES 8
+#define CHANNEL_GUARD_CANARY 0xA5
+#include <main.cpp>
+
+#define SOAK_LOOP_MICROS 500
+#define SOAK_TAP_MILLIS 500 // 120 bpm
+#define SOAK_TAPS 4
+#define SOAK_TAP_INTERVAL_MILLIS 180000 // between tap chains
+#define SOAK_MODE_INTERVAL_MILLIS 41000 // next pattern, every SOAK_PALETTE_EVERY'th press a long one for the next palette
+#define SOAK_PALETTE_EVERY 7
+#define SOAK_DROP_INTERVAL_MILLIS 67000
+#define SOAK_DROP_MILLIS 4000
+#define SOAK_BRIGHTNESS_INTERVAL_MILLIS 600000
+#define SOAK_AUTOPILOT_INTERVAL_MILLIS 2820000 // toggled by a mode+drop chord
+#define SOAK_SHAKE_INTERVAL_MILLIS 120000
+#define SOAK_SHAKE_MILLIS 3000
+#define SOAK_NOISE_INTERVAL_MILLIS 13000 // random bytes on the serial line
+#define SOAK_BEAT_TOLERANCE 3 // beats per minute off the tapped tempo
+#define SOAK_MAX_FRAME_MILLIS 250 // between frames shown, before they count as stalled
+
+// As in main.cpp
+const char *patternNames[] = {"Bpm", "Heartbeat", "Plasma", "Juggle", "Sinelon", "Confetti", "VmPattern", "Fire"};
+#define NUM_PATTERNS 8
+
+struct PatternStats {
+  uint32_t frames = 0;
+  uint32_t intervals = 0;
+  uint32_t minInterval = UINT32_MAX; // in microseconds
+  uint32_t maxInterval = 0;
+  double sumInterval = 0;
+  double sumSquares = 0;
+  uint64_t micros = 0; // on this pattern
+  uint64_t showMicros = 0; // transmitting
+  double change = 0; // summed FrameGovernor::getChange()
+  double millijoules = 0; // drawn by the LEDs
+} stats[NUM_PATTERNS];
+
+uint32_t violations = 0;
+uint32_t serialBytes = 0;
+
+/**
+ * Milliseconds relative to the wrap, for reports
+ */
+int32_t sinceWrap(uint32_t ms)
+{
+  return (int32_t)ms;
+}
+
+void report(const char *what, uint32_t ms)
+{
+  violations++;
+  if (violations <= 20) {
+    printf("FAIL %s: %s at %+" PRId32 "ms from the wrap\n", patternNames[patternList.getIndex()], what, sinceWrap(ms));
+  }
+}
+
+/**
+ * A frame mode program with a fading dot, placed with the LED count as the (out of range)
+ * upper bound, to check VM_AT keeps the cursor on the strip
+ */
+const byte vmProgram[] = {
+  VM_PUSH8, 20, VM_FADE,
+  VM_PUSH8, 30, VM_PUSH8, 0, VM_COUNT, VM_BEATSIN16, VM_AT,
+  VM_TIME, VM_PUSH8, 255, VM_PALETTE_ADD,
+  VM_END
+};
+
+void storeVmProgram()
+{
+  EEPROM.update(VM_EEPROM_SLOT_ADDRESS, 0);
+  EEPROM.update(VM_EEPROM_ADDRESS, VM_MAGIC);
+  EEPROM.update(VM_EEPROM_ADDRESS + 1, VM_MODE_FRAME);
+  EEPROM.update(VM_EEPROM_ADDRESS + 2, sizeof(vmProgram));
+  for (byte i = 0; i < sizeof(vmProgram); i++) {
+    EEPROM.update(VM_EEPROM_ADDRESS + VM_HEADER_SIZE + i, vmProgram[i]);
+  }
+}
+
+/**
+ * Fill the gap behind each channel's LEDs with canaries
+ */
+void fenceChannels()
+{
+  for (byte i = 0; i < NUM_STATES; i++) {
+    PatternState *state = channels.getState(i);
+    memset((byte *)(state->leds + state->ledsSize), CHANNEL_GUARD_CANARY, CHANNEL_GUARD_BYTES);
+  }
+}
+
+bool isFenceBroken()
+{
+  for (byte i = 0; i < NUM_STATES; i++) {
+    PatternState *state = channels.getState(i);
+    const byte *guard = (const byte *)(state->leds + state->ledsSize);
+    for (byte g = 0; g < CHANNEL_GUARD_BYTES; g++) {
+      if (guard[g] != CHANNEL_GUARD_CANARY) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Press (LOW) a button for the first pressMillis of every interval
+ */
+bool isPressed(uint32_t since, uint32_t interval, uint32_t pressMillis)
+{
+  return since % interval < pressMillis;
+}
+
+/**
+ * Set the buttons, accelerometer and serial input for the current time
+ */
+void input(uint32_t since)
+{
+  // Tap chains of SOAK_TAPS, once debouncing has settled
+  uint32_t sinceChain = (since + SOAK_TAP_INTERVAL_MILLIS - 1000) % SOAK_TAP_INTERVAL_MILLIS;
+  bool tapping = sinceChain < SOAK_TAPS * SOAK_TAP_MILLIS && sinceChain % SOAK_TAP_MILLIS < 60;
+  soakPins[BEAT_BUTTON_PIN] = tapping ? LOW : HIGH;
+
+  uint32_t modePress = since / SOAK_MODE_INTERVAL_MILLIS % SOAK_PALETTE_EVERY ? 100 : 700;
+  bool mode = isPressed(since, SOAK_MODE_INTERVAL_MILLIS, modePress);
+  bool drop = isPressed(since, SOAK_DROP_INTERVAL_MILLIS, SOAK_DROP_MILLIS);
+  // Chord: mode held from before until after drop's press
+  uint32_t sinceChord = since % SOAK_AUTOPILOT_INTERVAL_MILLIS;
+  if (since > SOAK_AUTOPILOT_INTERVAL_MILLIS / 2 && sinceChord < 1000) {
+    mode = sinceChord >= 100 && sinceChord < 900;
+    drop = sinceChord >= 300 && sinceChord < 500;
+  }
+  soakPins[MODE_BUTTON_PIN] = mode ? LOW : HIGH;
+  soakPins[DROP_BUTTON_PIN] = drop ? LOW : HIGH;
+  soakPins[BRIGHTNESS_BUTTON_PIN] = isPressed(since, SOAK_BRIGHTNESS_INTERVAL_MILLIS, 100) ? LOW : HIGH;
+
+  // At rest with gravity on z, swinging wildly while shaken
+  int swing = isPressed(since, SOAK_SHAKE_INTERVAL_MILLIS, SOAK_SHAKE_MILLIS) ? 300 : 4;
+  soakAnalog[ACCELX_PIN] = constrain(512 + random(-swing, swing + 1), 0, 1023);
+  soakAnalog[ACCELY_PIN] = constrain(512 + random(-swing, swing + 1), 0, 1023);
+  soakAnalog[ACCELZ_PIN] = constrain(700 + random(-swing, swing + 1), 0, 1023);
+
+  static uint32_t noiseMillis = 0;
+  if (since - noiseMillis >= SOAK_NOISE_INTERVAL_MILLIS) {
+    noiseMillis = since;
+    for (int i = random(1, 9); i > 0; i--) {
+      Serial.input.push_back(random(256));
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t minutes = argc > 1 ? atoi(argv[1]) : 540;
+  int seed = argc > 2 ? atoi(argv[2]) : 1;
+  srand(seed);
+  uint64_t duration = (uint64_t)minutes * 60000000;
+
+  memset(soakPins, HIGH, sizeof(soakPins));
+  soakMicros = ((1ULL << 32) - duration / 2000) * 1000;
+  uint64_t start = soakMicros;
+  storeVmProgram();
+
+  setup();
+  fenceChannels();
+  if (patternList.getCount() != NUM_PATTERNS) {
+    printf("FAIL main.cpp has %d patterns, the soak knows %d\n", patternList.getCount(), NUM_PATTERNS);
+    return 1;
+  }
+
+  uint32_t lastMillis = systemClock.millis();
+  uint64_t lastShowMicros = 0;
+  byte lastShowPattern = 0xFF;
+  uint64_t minuteMicros = soakMicros;
+  uint32_t beats = 0;
+  bool tappedThisMinute = false;
+
+  while (soakMicros - start < duration) {
+    uint32_t since = (soakMicros - start) / 1000;
+    input(since);
+    tappedThisMinute = tappedThisMinute || soakPins[BEAT_BUTTON_PIN] == LOW;
+
+    uint64_t loopMicros = soakMicros;
+    uint32_t shows = FastLED.shows;
+    loop();
+    output.flush(); // transmission time counts towards this loop, and FastLED's counters are settled
+    uint64_t showMicros = soakMicros - loopMicros;
+    soakMicros += SOAK_LOOP_MICROS + random(SOAK_LOOP_MICROS);
+
+    uint32_t currentMillis = systemClock.millis();
+    byte pattern = patternList.getIndex();
+    PatternStats &patternStats = stats[pattern];
+    uint64_t elapsed = soakMicros - loopMicros;
+    patternStats.micros += elapsed;
+    patternStats.showMicros += showMicros;
+    patternStats.millijoules += FastLED.milliwatts() * (elapsed / 1e6);
+    serialBytes += Serial.output.size();
+    Serial.output.clear();
+
+    if (FastLED.shows != shows) {
+      patternStats.frames++;
+#ifdef FRAME_GOVERNOR
+      patternStats.change += frameGovernor.getChange();
+#endif
+      if (pattern == lastShowPattern) {
+        uint32_t interval = FastLED.shownMicros - lastShowMicros;
+        patternStats.intervals++;
+        patternStats.minInterval = min(patternStats.minInterval, interval);
+        patternStats.maxInterval = max(patternStats.maxInterval, interval);
+        patternStats.sumInterval += interval;
+        patternStats.sumSquares += (double)interval * interval;
+      }
+      lastShowMicros = FastLED.shownMicros;
+      lastShowPattern = pattern;
+    }
+    if (soakMicros - lastShowMicros > SOAK_MAX_FRAME_MILLIS * 1000ULL && lastShowPattern != 0xFF) {
+      report("frames stalled", currentMillis);
+      lastShowMicros = soakMicros;
+    }
+
+    if (isFenceBroken()) {
+      report("write past a channel's LEDs", currentMillis);
+      fenceChannels();
+    }
+    if (currentMillis - lastMillis >= 0x80000000) {
+      report("clock went back", currentMillis);
+    }
+    lastMillis = currentMillis;
+    float progress = beatControl.beatProgress();
+    if (!(progress >= 0 && progress < 1)) {
+      report("beat progress out of range", currentMillis);
+    }
+
+    if (beatControl.onBeat()) {
+      beats++;
+    }
+    if (soakMicros - minuteMicros >= 60000000) {
+      int32_t expected = 60000 / SOAK_TAP_MILLIS;
+      if (!tappedThisMinute && abs((int32_t)beats - expected) > SOAK_BEAT_TOLERANCE) {
+        report("beat drifted off the tapped tempo", currentMillis);
+      }
+      minuteMicros = soakMicros;
+      beats = 0;
+      tappedThisMinute = false;
+    }
+  }
+
+  printf("Soaked %" PRIu32 " simulated minutes across the millis() wrap, seed %d\n", minutes, seed);
+  printf("  %-10s %7s %6s %27s %7s %6s %8s %7s", "pattern", "frames", "fps", "interval min/mean/max ms", "jitter", "show %", "energy J", "mean mW");
+#ifdef FRAME_GOVERNOR
+  printf(" %7s", "change");
+#endif
+  printf("\n");
+  for (byte p = 0; p < NUM_PATTERNS; p++) {
+    PatternStats &s = stats[p];
+    double seconds = s.micros / 1e6;
+    double mean = s.intervals ? s.sumInterval / s.intervals / 1000 : 0;
+    double jitter = s.intervals ? sqrt(max(s.sumSquares / s.intervals / 1e6 - mean * mean, 0.0)) : 0;
+    printf("  %-10s %7" PRIu32 " %6.1f %8.1f / %6.1f / %7.1f %7.2f %6.1f %8.1f %7.0f",
+      patternNames[p], s.frames, seconds ? s.frames / seconds : 0,
+      s.intervals ? s.minInterval / 1000.0 : 0, mean, s.maxInterval / 1000.0, jitter,
+      s.micros ? 100.0 * s.showMicros / s.micros : 0,
+      s.millijoules / 1000, seconds ? s.millijoules / seconds : 0);
+#ifdef FRAME_GOVERNOR
+    printf(" %7.0f", s.frames ? s.change / s.frames : 0);
+#endif
+    printf("\n");
+  }
+  printf("Clock lost %" PRIu32 "ms, %" PRIu32 " bytes of serial output\n", systemClock.getLostMillis(), serialBytes);
+  printf("%" PRIu32 " violations\n", violations);
+  return violations ? 1 : 0;
+}
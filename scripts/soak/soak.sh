@@ -0,0 +1,4 @@
+#!/bin/sh
+# Build the soak harness for the host and run it, see soak.cpp.
+# Usage: [SOAK_FLAGS=-DFRAME_GOVERNOR] scripts/soak/soak.sh [minutes] [seed]
+exec "$(dirname "$0")/run.sh" soak "$@"
@@ -0,0 +1,250 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Just enough of the Arduino core to run main.cpp on the host, see soak.cpp.
+// Times are uint32_t as on the Nano, where unsigned long is 32 bits,
+// so millis() wraps after 49.7 days here as well.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define DEC 10
+#define HEX 16
+
+#define PROGMEM
+#define F(string) (string)
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define memcpy_P memcpy
+
+#define noInterrupts()
+#define interrupts()
+
+template<class T, class U> auto min(T a, U b) -> decltype(a + b)
+{
+  return a < b ? a : b;
+}
+
+template<class T, class U> auto max(T a, U b) -> decltype(a + b)
+{
+  return a > b ? a : b;
+}
+
+template<class T, class U, class V> T constrain(T value, U low, V high)
+{
+  return value < low ? low : (value > high ? high : value);
+}
+
+/**
+ * Simulated time in microseconds, advanced by soak.cpp (and delay()).
+ * Atomic since with OUTPUT_PIPELINE_THREADED FastLED.show() advances it from the worker thread.
+ */
+extern std::atomic<uint64_t> soakMicros;
+
+inline uint32_t millis()
+{
+  return soakMicros / 1000;
+}
+
+inline uint32_t micros()
+{
+  return soakMicros;
+}
+
+inline void delay(uint32_t ms)
+{
+  soakMicros += (uint64_t)ms * 1000;
+}
+
+/**
+ * Simulated pin levels, all released (HIGH) unless soak.cpp presses a button
+ */
+extern byte soakPins[32];
+
+/**
+ * Simulated analog inputs (0-1023), e.g. the accelerometer
+ */
+extern int soakAnalog[32];
+
+inline int digitalRead(int pin)
+{
+  return soakPins[pin];
+}
+
+inline void digitalWrite(int pin, int level)
+{
+}
+
+inline void pinMode(int pin, int mode)
+{
+}
+
+inline int analogRead(int pin)
+{
+  return soakAnalog[pin];
+}
+
+inline int32_t random(int32_t limit)
+{
+  return limit > 0 ? rand() % limit : 0;
+}
+
+inline int32_t random(int32_t low, int32_t high)
+{
+  return low + random(high - low);
+}
+
+inline void randomSeed(uint32_t seed)
+{
+  srand(seed);
+}
+
+inline int32_t map(int32_t value, int32_t fromLow, int32_t fromHigh, int32_t toLow, int32_t toHigh)
+{
+  return (value - fromLow) * (toHigh - toLow) / (fromHigh - fromLow) + toLow;
+}
+
+/**
+ * Byte stream, e.g. a serial port or a loopback between two simulated devices
+ */
+struct Stream {
+  std::deque<uint8_t> input; // to be read, pushed by the harness
+  std::vector<uint8_t> output; // written, for the harness to inspect or clear
+
+  int available()
+  {
+    return input.size();
+  }
+
+  int read()
+  {
+    if (input.empty()) {
+      return -1;
+    }
+    uint8_t b = input.front();
+    input.pop_front();
+    return b;
+  }
+
+  size_t write(uint8_t b)
+  {
+    output.push_back(b);
+    return 1;
+  }
+
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    output.insert(output.end(), buffer, buffer + size);
+    return size;
+  }
+
+  size_t print(const char *text)
+  {
+    return write((const uint8_t *)text, strlen(text));
+  }
+
+  size_t print(char c)
+  {
+    return write((uint8_t)c);
+  }
+
+  size_t print(int32_t value, int base = DEC)
+  {
+    if (value < 0) {
+      return print('-') + print((uint32_t)-(int64_t)value, base);
+    }
+    return print((uint32_t)value, base);
+  }
+
+  size_t print(uint32_t value, int base = DEC)
+  {
+    char digits[33];
+    char *p = digits + sizeof(digits) - 1;
+    *p = 0;
+    do {
+      *--p = "0123456789ABCDEF"[value % base];
+      value /= base;
+    } while (value);
+    return print(p);
+  }
+
+  size_t print(uint8_t value, int base = DEC)
+  {
+    return print((uint32_t)value, base);
+  }
+
+  size_t print(uint16_t value, int base = DEC)
+  {
+    return print((uint32_t)value, base);
+  }
+
+  size_t print(int16_t value, int base = DEC)
+  {
+    return print((int32_t)value, base);
+  }
+
+  size_t print(double value, int digits = 2)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+  }
+
+  size_t println()
+  {
+    return print("\r\n");
+  }
+
+  template<class T> size_t println(T value)
+  {
+    return print(value) + println();
+  }
+
+  template<class T> size_t println(T value, int format)
+  {
+    return print(value, format) + println();
+  }
+};
+
+/**
+ * The USB serial port, which never runs out of transmit buffer
+ */
+struct HardwareSerial: Stream {
+  uint32_t baudRate = 0;
+
+  void begin(uint32_t baud)
+  {
+    baudRate = baud;
+  }
+
+  int availableForWrite()
+  {
+    return 63;
+  }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+#define EEPROM_SIZE 1024
+
+/**
+ * The Nano's 1KB EEPROM, blank (0xFF) until written
+ */
+struct EEPROMClass {
+  uint8_t data[EEPROM_SIZE];
+
+  EEPROMClass()
+  {
+    memset(data, 0xFF, sizeof(data));
+  }
+
+  uint8_t read(int address)
+  {
+    return (address >= 0 && address < EEPROM_SIZE) ? data[address] : 0xFF;
+  }
+
+  void update(int address, uint8_t value)
+  {
+    if (address >= 0 && address < EEPROM_SIZE) {
+      data[address] = value;
+    }
+  }
+
+  void write(int address, uint8_t value)
+  {
+    update(address, value);
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
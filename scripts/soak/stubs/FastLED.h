@@ -0,0 +1,415 @@
+#ifndef FastLED_h
+#define FastLED_h
+
+// The parts of FastLED main.cpp uses, for the host, see soak.cpp.
+// Ranges and rounding follow FastLED (e.g. beatsin16() includes its upper bound),
+// since that is what decides whether an index stays within the strip.
+// Transmitting takes simulated time, and power follows FastLED's power model.
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+
+uint32_t get_millisecond_timer();
+
+inline uint8_t scale8(uint8_t i, fract8 scale)
+{
+  return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale)
+{
+  return (((uint16_t)i * scale) >> 8) + (i && scale ? 1 : 0);
+}
+
+inline uint16_t scale16(uint16_t i, uint16_t scale)
+{
+  return ((uint32_t)i * (1 + (uint32_t)scale)) >> 16;
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j)
+{
+  return min(i + j, 255);
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j)
+{
+  return i > j ? i - j : 0;
+}
+
+inline int16_t sin16(uint16_t theta)
+{
+  return (int16_t)lround(sin(theta * (2 * M_PI / 65536)) * 32767);
+}
+
+inline uint8_t sin8(uint8_t theta)
+{
+  return (uint8_t)lround(127.5 + sin(theta * (2 * M_PI / 256)) * 127.5);
+}
+
+inline uint8_t random8()
+{
+  return rand() & 0xFF;
+}
+
+inline uint8_t random8(uint8_t limit)
+{
+  return (random8() * limit) >> 8;
+}
+
+inline uint16_t random16()
+{
+  return rand() & 0xFFFF;
+}
+
+inline uint16_t random16(uint16_t limit)
+{
+  return ((uint32_t)random16() * limit) >> 16;
+}
+
+inline uint16_t beat88(uint16_t bpm88, uint32_t timebase = 0)
+{
+  return ((get_millisecond_timer() - timebase) * bpm88 * 280) >> 16;
+}
+
+inline uint16_t beat16(uint16_t bpm, uint32_t timebase = 0)
+{
+  if (bpm < 256) {
+    bpm <<= 8;
+  }
+  return beat88(bpm, timebase);
+}
+
+inline uint8_t beat8(uint16_t bpm, uint32_t timebase = 0)
+{
+  return beat16(bpm, timebase) >> 8;
+}
+
+inline uint16_t beatsin16(uint16_t bpm, uint16_t low = 0, uint16_t high = 65535, uint32_t timebase = 0, uint16_t phase = 0)
+{
+  uint16_t beatsin = sin16(beat16(bpm, timebase) + phase) + 32768;
+  return low + scale16(beatsin, high - low);
+}
+
+struct CHSV {
+  uint8_t h, s, v;
+
+  CHSV(uint8_t hue, uint8_t saturation, uint8_t value): h(hue), s(saturation), v(value)
+  {
+  }
+};
+
+struct CRGB {
+  uint8_t r, g, b;
+
+  enum HTMLColorCode {
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    DarkBlue = 0x00008B,
+    DarkRed = 0x8B0000,
+    LightBlue = 0xADD8E6,
+    Maroon = 0x800000,
+    Orange = 0xFFA500,
+    Red = 0xFF0000,
+    SkyBlue = 0x87CEEB,
+    White = 0xFFFFFF
+  };
+
+  CRGB(): r(0), g(0), b(0)
+  {
+  }
+
+  CRGB(uint8_t red, uint8_t green, uint8_t blue): r(red), g(green), b(blue)
+  {
+  }
+
+  CRGB(uint32_t code): r(code >> 16), g(code >> 8), b(code)
+  {
+  }
+
+  CRGB(HTMLColorCode code): CRGB((uint32_t)code)
+  {
+  }
+
+  CRGB(const CHSV &hsv)
+  {
+    // Six linear sectors, close enough to FastLED's rainbow for soaking
+    uint8_t sector = (hsv.h * 6) >> 8;
+    uint8_t rise = (hsv.h * 6) & 0xFF;
+    uint8_t low = scale8(hsv.v, 255 - hsv.s);
+    uint8_t up = low + scale8(hsv.v - low, rise);
+    uint8_t down = hsv.v - scale8(hsv.v - low, rise);
+    uint8_t values[6][3] = {
+      {hsv.v, up, low}, {down, hsv.v, low}, {low, hsv.v, up},
+      {low, down, hsv.v}, {up, low, hsv.v}, {hsv.v, low, down}
+    };
+    r = values[sector][0];
+    g = values[sector][1];
+    b = values[sector][2];
+  }
+
+  CRGB &operator+=(const CRGB &other)
+  {
+    r = qadd8(r, other.r);
+    g = qadd8(g, other.g);
+    b = qadd8(b, other.b);
+    return *this;
+  }
+
+  CRGB &operator|=(const CRGB &other)
+  {
+    r = max(r, other.r);
+    g = max(g, other.g);
+    b = max(b, other.b);
+    return *this;
+  }
+
+  CRGB &nscale8(uint8_t scale)
+  {
+    r = scale8(r, scale);
+    g = scale8(g, scale);
+    b = scale8(b, scale);
+    return *this;
+  }
+
+  CRGB &fadeToBlackBy(uint8_t fade)
+  {
+    return nscale8(255 - fade);
+  }
+
+  uint8_t &operator[](uint8_t index)
+  {
+    return index == 0 ? r : (index == 1 ? g : b);
+  }
+
+  const uint8_t &operator[](uint8_t index) const
+  {
+    return index == 0 ? r : (index == 1 ? g : b);
+  }
+
+  explicit operator bool() const
+  {
+    return r || g || b;
+  }
+
+  bool operator==(const CRGB &other) const
+  {
+    return r == other.r && g == other.g && b == other.b;
+  }
+
+  bool operator!=(const CRGB &other) const
+  {
+    return !(*this == other);
+  }
+};
+
+struct CRGBPalette16 {
+  CRGB entries[16];
+
+  CRGBPalette16()
+  {
+  }
+
+  template<class... Colors> CRGBPalette16(Colors... colors): entries{CRGB(colors)...}
+  {
+  }
+};
+
+enum TBlendType { NOBLEND, LINEARBLEND };
+
+inline CRGB ColorFromPalette(const CRGBPalette16 &palette, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND)
+{
+  CRGB color = palette.entries[index >> 4];
+  if (blendType == LINEARBLEND) {
+    const CRGB &next = palette.entries[((index >> 4) + 1) & 15];
+    uint8_t amount = (index & 15) << 4;
+    color.r = scale8(color.r, 255 - amount) + scale8(next.r, amount);
+    color.g = scale8(color.g, 255 - amount) + scale8(next.g, amount);
+    color.b = scale8(color.b, 255 - amount) + scale8(next.b, amount);
+  }
+  return color.nscale8(brightness);
+}
+
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 amount)
+{
+  return b > a ? a + scale8(b - a, amount) : a - scale8(a - b, amount);
+}
+
+inline CRGB blend(const CRGB &from, const CRGB &to, fract8 amount)
+{
+  return CRGB(lerp8by8(from.r, to.r, amount), lerp8by8(from.g, to.g, amount), lerp8by8(from.b, to.b, amount));
+}
+
+inline void fill_solid(CRGB *leds, int count, const CRGB &color)
+{
+  for (int i = 0; i < count; i++) {
+    leds[i] = color;
+  }
+}
+
+inline void fadeToBlackBy(CRGB *leds, uint16_t count, uint8_t fade)
+{
+  for (uint16_t i = 0; i < count; i++) {
+    leds[i].fadeToBlackBy(fade);
+  }
+}
+
+struct CEveryNMillis {
+  uint32_t period;
+  uint32_t previous;
+
+  CEveryNMillis(uint32_t _period): period(_period), previous(get_millisecond_timer())
+  {
+  }
+
+  bool ready()
+  {
+    uint32_t now = get_millisecond_timer();
+    if (now - previous < period) {
+      return false;
+    }
+    previous = now;
+    return true;
+  }
+};
+
+#define NEOPIXEL 0
+#define TypicalLEDStrip 0xFFB0F0
+#define UncorrectedColor 0xFFFFFF
+
+// FastLED's power model, per LED at full brightness
+#define POWER_RED_MW (16 * 5)
+#define POWER_GREEN_MW (11 * 5)
+#define POWER_BLUE_MW (15 * 5)
+#define POWER_DARK_MW (1 * 5)
+
+#define TRANSMIT_MICROS_PER_LED 30 // 24 bits at 800kHz
+
+/**
+ * @return What the LEDs draw at full brightness, in mW
+ */
+inline uint32_t calculate_unscaled_power_mW(const CRGB *leds, uint16_t count)
+{
+  uint32_t red = 0, green = 0, blue = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    red += leds[i].r;
+    green += leds[i].g;
+    blue += leds[i].b;
+  }
+  return ((red * POWER_RED_MW + green * POWER_GREEN_MW + blue * POWER_BLUE_MW) >> 8) + count * POWER_DARK_MW;
+}
+
+/**
+ * A strip on a pin, which counts what it transmitted
+ */
+struct CLEDController {
+  CRGB *leds = 0;
+  uint16_t count = 0;
+  CRGB correction = CRGB(UncorrectedColor);
+  uint32_t shows = 0;
+  uint32_t milliwatts = 0; // drawn by the last frame shown, until the next one
+
+  CLEDController &setCorrection(CRGB _correction)
+  {
+    correction = _correction;
+    return *this;
+  }
+
+  /**
+   * Transmit, which takes TRANSMIT_MICROS_PER_LED with interrupts off
+   */
+  void showLeds(uint8_t brightness = 255)
+  {
+    milliwatts = (calculate_unscaled_power_mW(leds, count) - count * POWER_DARK_MW) * brightness / 256 + count * POWER_DARK_MW;
+    shows++;
+    soakMicros += (uint64_t)count * TRANSMIT_MICROS_PER_LED;
+  }
+};
+
+#define MAX_CONTROLLERS 8
+
+struct CFastLED {
+  CLEDController controllers[MAX_CONTROLLERS];
+  uint8_t numControllers = 0;
+  uint8_t brightness = 255;
+  uint32_t maxMilliwatts = 0;
+  uint32_t shows = 0;
+  uint64_t shownMicros = 0; // when the last show() started
+  void (*onTransmit)(const CLEDController &controller) = 0; // lets host programs see each strip go out
+
+  template<int TYPE, int PIN> CLEDController &addLeds(CRGB *leds, int count)
+  {
+    CLEDController &controller = controllers[numControllers++];
+    controller.leds = leds;
+    controller.count = count;
+    return controller;
+  }
+
+  void setBrightness(uint8_t _brightness)
+  {
+    brightness = _brightness;
+  }
+
+  uint8_t getBrightness()
+  {
+    return brightness;
+  }
+
+  void setMaxPowerInVoltsAndMilliamps(uint8_t volts, uint32_t milliamps)
+  {
+    maxMilliwatts = volts * milliamps;
+  }
+
+  void show();
+
+  /**
+   * Drawn by all strips, as of the frames they showed last
+   */
+  uint32_t milliwatts()
+  {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < numControllers; i++) {
+      total += controllers[i].milliwatts;
+    }
+    return total;
+  }
+};
+
+extern CFastLED FastLED;
+
+/**
+ * Scale brightness down so all strips together draw at most maxMilliwatts
+ */
+inline uint8_t calculate_max_brightness_for_power_mW(uint8_t brightness, uint32_t maxMilliwatts)
+{
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < FastLED.numControllers; i++) {
+    total += calculate_unscaled_power_mW(FastLED.controllers[i].leds, FastLED.controllers[i].count);
+  }
+  uint32_t requested = total * brightness / 256;
+  if (requested <= maxMilliwatts) {
+    return brightness;
+  }
+  return brightness * maxMilliwatts / requested;
+}
+
+inline void CFastLED::show()
+{
+  shownMicros = soakMicros;
+  uint8_t limited = maxMilliwatts ? calculate_max_brightness_for_power_mW(brightness, maxMilliwatts) : brightness;
+  for (uint8_t i = 0; i < numControllers; i++) {
+    controllers[i].showLeds(limited);
+    if (onTransmit) {
+      onTransmit(controllers[i]);
+    }
+  }
+  shows++;
+}
+
+#define EVERY_N_CONCAT2(a, b) a##b
+#define EVERY_N_CONCAT(a, b) EVERY_N_CONCAT2(a, b)
+#define EVERY_N_MILLISECONDS(N) \
+  static CEveryNMillis EVERY_N_CONCAT(everyN, __LINE__)(N); \
+  if (EVERY_N_CONCAT(everyN, __LINE__).ready())
+
+#endif
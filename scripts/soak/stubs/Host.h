@@ -0,0 +1,17 @@
+#ifndef Host_h
+#define Host_h
+
+// The simulated hardware behind the stubs, included once by each host program in scripts/soak
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <EEPROM.h>
+
+std::atomic<uint64_t> soakMicros(0);
+byte soakPins[32];
+int soakAnalog[32];
+HardwareSerial Serial;
+CFastLED FastLED;
+EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,220 @@
+/**
+ * Runs a BeatSync leader and follower against each other over a simulated serial link,
+ * as main.cpp does with SYNC_LEADER and SYNC_FOLLOWER. Run with run.sh sync.
+ *
+ * Each device has a clock of its own (offset, and running fast or slow like the Nano's
+ * ceramic resonator) and loops every SYNC_MIN_LOOP_MILLIS to SYNC_MAX_LOOP_MILLIS, as
+ * frames take. Bytes arrive at the baud rate, and the follower reads them once per loop.
+ * Halfway through, the leader changes tempo.
+ *
+ * Every 10ms of real time, the bar phases of both are compared. Reports how long the follower
+ * takes to get within SYNC_MAX_ERROR_MILLIS for good (after the start and the tempo change),
+ * the phase error from then on, and the bytes per second the leader sends.
+ * Fails when settling takes longer than SYNC_MAX_SETTLE_MILLIS, the error exceeds
+ * SYNC_MAX_ERROR_MILLIS once settled, or the link takes more than SYNC_MAX_BYTES_PER_SECOND.
+ *
+ * Usage: sync [minutes] [seed]
+ */
+#include <algorithm>
+#include <Host.h>
+#include <BeatControl.h>
+#include <BeatSync.h>
+
+#define SYNC_MIN_LOOP_MILLIS 5
+#define SYNC_MAX_LOOP_MILLIS 40
+#define SYNC_SAMPLE_MILLIS 10
+#define SYNC_MAX_SETTLE_MILLIS 30000
+#define SYNC_MAX_ERROR_MILLIS 45 // about where audiences start to notice light ahead of sound
+#define SYNC_SETTLED_MILLIS 5000 // within SYNC_MAX_ERROR_MILLIS for this long
+#define SYNC_MAX_BYTES_PER_SECOND 30
+
+struct Device {
+  BeatControl beat;
+  uint32_t offsetMillis;
+  int32_t ppm; // how fast the clock runs
+  uint64_t nextLoopMicros = 0;
+
+  Device(uint32_t _offsetMillis, int32_t _ppm): beat(-1), offsetMillis(_offsetMillis), ppm(_ppm)
+  {
+    // no-op
+  }
+
+  uint32_t millisAt(uint64_t micros)
+  {
+    return offsetMillis + (uint32_t)((micros + micros * ppm / 1000000) / 1000);
+  }
+
+  /**
+   * @return Whether the device loops at this time
+   */
+  bool due(uint64_t micros)
+  {
+    if (micros < nextLoopMicros) {
+      return false;
+    }
+    nextLoopMicros = micros + random(SYNC_MIN_LOOP_MILLIS, SYNC_MAX_LOOP_MILLIS + 1) * 1000;
+    return true;
+  }
+};
+
+/**
+ * One way serial line, bytes arrive one after the other at the baud rate
+ */
+struct Link {
+  uint32_t baudRate;
+  std::deque<std::pair<uint64_t, byte>> bytes; // arrival time, byte
+  uint64_t freeMicros = 0; // when the line is idle again
+  uint32_t sent = 0;
+
+  Link(uint32_t _baudRate): baudRate(_baudRate)
+  {
+    // no-op
+  }
+
+  void send(Stream &from, uint64_t micros)
+  {
+    for (byte b : from.output) {
+      freeMicros = max(freeMicros, micros) + 10000000ULL / baudRate;
+      bytes.push_back(std::make_pair(freeMicros, b));
+      sent++;
+    }
+    from.output.clear();
+  }
+};
+
+struct Result {
+  std::vector<int> errors; // once settled, absolute
+  uint32_t settleMillis = 0; // longest time to get within SYNC_MAX_ERROR_MILLIS, after the start or the tempo change
+  float bytesPerSecond;
+};
+
+int32_t barError(Device &leader, Device &follower)
+{
+  int32_t bar = leader.beat.getBeatLength() * 4;
+  int32_t error = ((int32_t)leader.beat.barPhase() - (int32_t)follower.beat.barPhase()) % bar;
+  if (error > bar / 2) {
+    error -= bar;
+  } else if (error < -bar / 2) {
+    error += bar;
+  }
+  return error;
+}
+
+Result run(uint32_t minutes, uint32_t baudRate, int32_t followerPpm)
+{
+  soakMicros = 0; // ArduinoTapTempo starts its chain at millis()
+  Device leader(1000000, 0);
+  Device follower(5000000 + random(100000), followerPpm);
+  BeatSync leaderSync(baudRate);
+  BeatSync followerSync(baudRate);
+  Stream leaderSerial;
+  Link link(baudRate);
+  Result result;
+
+  leader.beat.follow(468, 700); // 128 bpm, somewhere into the bar
+  uint64_t duration = (uint64_t)minutes * 60000000;
+  uint64_t changeMicros = duration / 2;
+  uint64_t lastSyncMicros = 0;
+  uint64_t settlingFrom = 0;
+  uint64_t withinFrom = 0; // since when the error has been within SYNC_MAX_ERROR_MILLIS
+  bool settled = false;
+
+  for (uint64_t micros = 0; micros < duration; micros += 1000) {
+    if (micros == changeMicros) {
+      leader.beat.follow(400, 0); // 150 bpm
+      settlingFrom = micros;
+      withinFrom = micros;
+      settled = false;
+    }
+
+    if (leader.due(micros)) {
+      uint32_t ms = leader.millisAt(micros);
+      leader.beat.update(ms);
+      if (micros - lastSyncMicros >= SYNC_INTERVAL_MILLIS * 1000) {
+        lastSyncMicros = micros;
+        soakMicros = (uint64_t)ms * 1000; // the leader stamps frames with systemClock
+        systemClock.update();
+        leaderSync.send(leaderSerial, leader.beat.getBeatLength(), leader.beat.barPhase(), 0, 0, false);
+        link.send(leaderSerial, micros);
+      }
+    }
+
+    if (follower.due(micros)) {
+      uint32_t ms = follower.millisAt(micros);
+      follower.beat.update(ms);
+      while (!link.bytes.empty() && link.bytes.front().first <= micros) {
+        if (followerSync.receive(link.bytes.front().second, ms)) {
+          follower.beat.follow(followerSync.getBeatLength(), followerSync.getCorrection(follower.beat.barPhase()));
+        }
+        link.bytes.pop_front();
+      }
+    }
+
+    if (micros % (SYNC_SAMPLE_MILLIS * 1000) == 0) {
+      leader.beat.update(leader.millisAt(micros));
+      follower.beat.update(follower.millisAt(micros));
+      int error = abs(barError(leader, follower));
+      if (!settled) {
+        if (error > SYNC_MAX_ERROR_MILLIS) {
+          withinFrom = micros + SYNC_SAMPLE_MILLIS * 1000;
+        }
+        if (micros >= withinFrom + SYNC_SETTLED_MILLIS * 1000) {
+          settled = true;
+          result.settleMillis = max(result.settleMillis, (uint32_t)((withinFrom - settlingFrom) / 1000));
+        }
+      } else {
+        result.errors.push_back(error);
+      }
+    }
+  }
+
+  if (!settled) {
+    result.settleMillis = max(result.settleMillis, (uint32_t)((duration - settlingFrom) / 1000));
+  }
+  result.bytesPerSecond = link.sent / (duration / 1e6);
+  return result;
+}
+
+int failures = 0;
+
+void check(const char *name, uint32_t minutes, uint32_t baudRate, int32_t ppm)
+{
+  Result result = run(minutes, baudRate, ppm);
+  std::vector<int> &errors = result.errors;
+  std::sort(errors.begin(), errors.end());
+  if (errors.empty()) {
+    errors.push_back(INT16_MAX); // never settled
+  }
+  double sum = 0;
+  for (int error : errors) {
+    sum += error;
+  }
+  int p99 = errors[errors.size() * 99 / 100];
+  int worst = errors.back();
+  bool ok = worst <= SYNC_MAX_ERROR_MILLIS && result.settleMillis <= SYNC_MAX_SETTLE_MILLIS
+    && result.bytesPerSecond <= SYNC_MAX_BYTES_PER_SECOND;
+  if (!ok) {
+    failures++;
+  }
+  printf("%s %-22s %6.2f %5d %5d %8u %8.1f\n",
+    ok ? "ok  " : "FAIL", name, sum / errors.size(), p99, worst, result.settleMillis, result.bytesPerSecond);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t minutes = argc > 1 ? atoi(argv[1]) : 10;
+  srand(argc > 2 ? atoi(argv[2]) : 1);
+  systemClock.setup();
+
+  printf("Phase error in ms once settled, over %u minutes each\n", minutes);
+  printf("     link                    mean   p99   max settle ms  bytes/s\n");
+  check("9600 baud", minutes, 9600, 0);
+  check("9600 baud, +0.5% clock", minutes, 9600, 5000);
+  check("9600 baud, -0.5% clock", minutes, 9600, -5000);
+  check("115200 baud", minutes, 115200, 0);
+  check("115200 baud, +0.5%", minutes, 115200, 5000);
+  check("9600 baud, +1% clock", minutes, 9600, 10000);
+  check("9600 baud, -1% clock", minutes, 9600, -10000);
+  printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
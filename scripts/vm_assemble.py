@@ -0,0 +1,162 @@
+"""
+Assembles a VmPattern program and optionally uploads it over serial.
+
+    python scripts/vm_assemble.py program.vm                  # print bytecode
+    python scripts/vm_assemble.py program.vm /dev/ttyUSB0     # upload (needs pyserial)
+
+Uploads use the remote control protocol (see scripts/remote.py), a chunk at a time,
+waiting for the firmware to store each one, see src/VmUploader.h.
+
+A program starts with its mode ("mode pixel" or "mode frame"), followed by
+one instruction per line. Labels end with a colon and can be used as jump targets.
+Opcodes and their operands are documented in src/VmPattern.h.
+For example, a plasma running once per LED:
+
+    mode pixel
+    index
+    push8 30
+    mul
+    time
+    sub
+    sin8
+    push8 200
+    scale8
+    push8 255
+    palette
+"""
+
+import sys
+import time
+
+import remote
+
+MAGIC = 0xB5
+MAX_LENGTH = 250
+CHUNK_SIZE = 15
+VM_BEGIN, VM_DATA, VM_COMMIT = 0x08, 0x09, 0x0A
+UPLOAD_OK, UPLOAD_BUSY = 0, 1
+MODES = {"frame": 0, "pixel": 1}
+
+# name: (opcode, immediate bytes)
+OPCODES = {
+    "end": (0x00, 0), "push8": (0x01, 1), "push16": (0x02, 2),
+    "dup": (0x03, 0), "pop": (0x04, 0), "swap": (0x05, 0),
+    "add": (0x10, 0), "sub": (0x11, 0), "mul": (0x12, 0), "div": (0x13, 0),
+    "mod": (0x14, 0), "and": (0x15, 0), "or": (0x16, 0), "xor": (0x17, 0),
+    "shl": (0x18, 0), "shr": (0x19, 0), "lt": (0x1A, 0), "eq": (0x1B, 0),
+    "index": (0x20, 0), "count": (0x21, 0), "time": (0x22, 0), "bpm": (0x23, 0),
+    "beat": (0x24, 0), "dropping": (0x25, 0),
+    "sin8": (0x30, 0), "scale8": (0x31, 0), "beatsin16": (0x32, 0), "random8": (0x33, 0),
+    "jmp": (0x40, 1), "jz": (0x41, 1),
+    "at": (0x50, 0), "palette": (0x51, 0), "palette_add": (0x52, 0), "hsv": (0x53, 0),
+    "fade": (0x54, 0),
+}
+JUMPS = ("jmp", "jz")
+
+
+def tokenize(source):
+    for line_number, line in enumerate(source.splitlines(), 1):
+        line = line.split(";")[0].split("#")[0].strip()
+        if line:
+            yield line_number, line.lower().split()
+
+
+def assemble(source):
+    """Returns (mode, code bytes)"""
+    mode = None
+    instructions = []
+    labels = {}
+    address = 0
+
+    # First pass: sizes and label addresses
+    for line_number, tokens in tokenize(source):
+        if tokens[0] == "mode":
+            if len(tokens) != 2 or tokens[1] not in MODES:
+                raise ValueError("line %d: mode should be pixel or frame" % line_number)
+            mode = MODES[tokens[1]]
+        elif tokens[0].endswith(":"):
+            labels[tokens[0][:-1]] = address
+        elif tokens[0] in OPCODES:
+            opcode, immediate = OPCODES[tokens[0]]
+            if len(tokens) != 1 + (1 if immediate else 0):
+                raise ValueError("line %d: %s takes %d operand(s)" % (line_number, tokens[0], 1 if immediate else 0))
+            instructions.append((line_number, address, tokens))
+            address += 1 + immediate
+        else:
+            raise ValueError("line %d: unknown instruction '%s'" % (line_number, tokens[0]))
+
+    if mode is None:
+        raise ValueError("missing mode (pixel or frame)")
+
+    # Second pass: encode
+    code = []
+    for line_number, address, tokens in instructions:
+        opcode, immediate = OPCODES[tokens[0]]
+        code.append(opcode)
+        if tokens[0] in JUMPS:
+            if tokens[1] not in labels:
+                raise ValueError("line %d: unknown label '%s'" % (line_number, tokens[1]))
+            offset = labels[tokens[1]] - (address + 2)
+            if not -128 <= offset <= 127:
+                raise ValueError("line %d: jump too far" % line_number)
+            code.append(offset & 0xFF)
+        elif immediate:
+            value = int(tokens[1], 0)
+            if not 0 <= value < (1 << (8 * immediate)):
+                raise ValueError("line %d: operand out of range" % line_number)
+            for i in range(immediate):
+                code.append((value >> (8 * i)) & 0xFF)
+
+    if len(code) > MAX_LENGTH:
+        raise ValueError("program is %d bytes, max. %d" % (len(code), MAX_LENGTH))
+    return mode, code
+
+
+def checksum(mode, code):
+    """XOR of mode, length and code, see VmUploader.h"""
+    result = mode ^ len(code)
+    for b in code:
+        result ^= b
+    return result
+
+
+def send(port, command, payload, retries=50):
+    """Send an upload command, again while the firmware is still writing the last chunk"""
+    for _ in range(retries):
+        port.write(remote.frame(command, payload))
+        status = remote.read_reply(port, command)[0]
+        if status != UPLOAD_BUSY:
+            return status
+        time.sleep(0.02)
+    return UPLOAD_BUSY
+
+
+def upload(port, mode, code):
+    if send(port, VM_BEGIN, [mode, len(code)]) != UPLOAD_OK:
+        raise ValueError("upload refused")
+    for offset in range(0, len(code), CHUNK_SIZE):
+        if send(port, VM_DATA, [offset] + code[offset:offset + CHUNK_SIZE]) != UPLOAD_OK:
+            raise ValueError("upload failed at byte %d" % offset)
+    if send(port, VM_COMMIT, [checksum(mode, code)]) != UPLOAD_OK:
+        raise ValueError("checksum mismatch, the previous program is still in use")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) not in (2, 3):
+        sys.exit("Usage: %s <program.vm> [serial port]" % sys.argv[0])
+    with open(sys.argv[1]) as f:
+        try:
+            mode, code = assemble(f.read())
+        except ValueError as e:
+            sys.exit(str(e))
+
+    print("mode %d, %d bytes: %s" % (mode, len(code), " ".join("%02X" % b for b in code)))
+    if len(sys.argv) == 3:
+        import serial  # pyserial
+        with serial.Serial(sys.argv[2], remote.BAUD_RATE, timeout=0.1) as port:
+            time.sleep(2)  # opening the port resets the Nano
+            try:
+                upload(port, mode, code)
+            except (ValueError, TimeoutError) as e:
+                sys.exit(str(e))
+        print("stored")
@@ -116,4 +116,14 @@ public:
     return adjustedMagnitude;
   }
 
+  /**
+   * Single raw reading of all axes, e.g. for GestureControl
+   */
+  void read(int &x, int &y, int &z)
+  {
+    x = analogRead(xPin);
+    y = analogRead(yPin);
+    z = analogRead(zPin);
+  }
+
 };
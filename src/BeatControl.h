@@ -1,8 +1,18 @@
 #include <ArduinoTapTempo.h>
+#include "ButtonEvents.h"
 
 class BeatControl {
   int pin;
   ArduinoTapTempo tapTempo;
+  bool _pressed = false;
+  bool _tapped = false; // pressed since the last update, even if already released
+  uint32_t _tapMillis = 0;
+  uint32_t _lookahead = 0;
+  uint32_t _phase = 0; // into the tap chain, as of the time the current frame is shown
+  uint32_t _updateMillis = 0;
+  uint32_t _beatMillis = 0; // when onBeat() was last true
+  bool _corrected = false; // phase, tempo or lookahead moved since the last update
+  bool _onBeat = false;
 
 public:
   BeatControl(int _pin): pin(_pin)
@@ -10,15 +20,69 @@ public:
     // no-op
   }
 
-  void setup()
+  void setup(ButtonEvents &events)
   {
-    pinMode(pin, INPUT_PULLUP);
+    events.attach(pin);
   }
 
-  void update()
+  void handle(const ButtonEvent &event)
   {
-    boolean buttonDown = digitalRead(pin) == LOW;
-    tapTempo.update(buttonDown);
+    if (event.pin != pin) {
+      return;
+    }
+    _pressed = event.pressed;
+    if (event.pressed) {
+      _tapped = true;
+      _tapMillis = event.millis;
+    }
+  }
+
+  /**
+   * @param ms Current time, see Clock
+   */
+  void update(uint32_t ms)
+  {
+    tapTempo.update(_pressed || _tapped, _tapMillis, ms);
+    _tapped = false;
+
+    uint32_t length = tapTempo.getBeatLength();
+    uint32_t phaseOld = _phase;
+    _phase = tapTempo.getMillisSinceReset() + _lookahead;
+
+    bool crossed;
+    if (_corrected) {
+      // The previous phase is on the old timeline. Check the time since the last update
+      // on the corrected one instead, so moving back or changing tempo doesn't look like a beat.
+      // A jump forward across a beat still counts, since it hasn't been shown yet.
+      uint32_t elapsed = ms - _updateMillis;
+      if (elapsed < _phase) {
+        phaseOld = min(phaseOld, _phase - elapsed);
+      }
+      crossed = phaseOld < _phase && (_phase / length) > (phaseOld / length);
+      _corrected = false;
+    } else {
+      // Taps restart the chain, and count as a beat
+      crossed = (_phase % length) < (phaseOld % length);
+    }
+    // A beat shown again after moving back across it doesn't count twice
+    _onBeat = crossed && ms - _beatMillis >= length / 2;
+    if (_onBeat) {
+      _beatMillis = ms;
+    }
+    _updateMillis = ms;
+  }
+
+  /**
+   * Report beats this far ahead, for the time the current frame will be visible.
+   * Applies to onBeat(), onBar(), beatProgress() and millisUntilBeat(),
+   * but not to barPhase(), which is shared with other devices.
+   */
+  void setLookahead(uint32_t ms)
+  {
+    if (ms != _lookahead) {
+      _lookahead = ms;
+      _corrected = true;
+    }
   }
 
   float getBpm()
@@ -26,13 +90,60 @@ public:
     return tapTempo.getBPM();
   }
 
+  /**
+   * True for the update a beat starts on. At most once per half beat,
+   * even when follow() moves the phase back across a beat.
+   */
   bool onBeat()
   {
-    return tapTempo.onBeat();
+    return _onBeat;
+  }
+
+  /**
+   * True on the first beat of a (four beat) bar, counted from the first tap of the chain
+   */
+  bool onBar()
+  {
+    return onBeat() && millisUntilBeat(4) > getBeatLength() * 3;
   }
 
   float beatProgress()
   {
-    return tapTempo.beatProgress();
+    uint32_t length = tapTempo.getBeatLength();
+    return (float)(_phase % length) / length;
+  }
+
+  uint32_t getBeatLength()
+  {
+    return tapTempo.getBeatLength();
+  }
+
+  /**
+   * Milliseconds into the current (four beat) bar
+   */
+  uint32_t barPhase()
+  {
+    return tapTempo.getMillisSinceReset() % (tapTempo.getBeatLength() * 4);
+  }
+
+  /**
+   * Follow another device's beat, see BeatSync
+   * @param correction How far to move the bar phase
+   */
+  void follow(uint32_t beatLength, int32_t correction)
+  {
+    tapTempo.setBeatLength(beatLength);
+    tapTempo.shiftPhase(correction);
+    _corrected = true;
+  }
+
+  /**
+   * Time until the next multiple of a number of beats (e.g. 4 for the next bar),
+   * counted from the first tap of the chain
+   */
+  uint32_t millisUntilBeat(byte beats)
+  {
+    uint32_t length = tapTempo.getBeatLength() * beats;
+    return length - (_phase % length);
   }
 };
@@ -0,0 +1,147 @@
+#ifndef BeatScheduler_h
+#define BeatScheduler_h
+
+/**
+ * Queues pattern, palette and drop changes until they line up with the music.
+ *
+ * Pattern and palette changes fire on the next boundary of a fixed number of beats
+ * (1 for every beat, 2 for half a bar, 4 for a bar), counted from the start of the tap chain.
+ * Pressing again before the boundary queues another step.
+ * Switching patterns runs setup(), so the scheduler flags the upcoming pattern
+ * a "pre-roll" ahead of the boundary, to set it up before the downbeat rather than on it.
+ *
+ * Drops should still feel instant, so they only snap to the next beat
+ * when pressed slightly ahead of it. Presses after the beat (already late) apply immediately.
+ */
+class BeatScheduler {
+  byte _beatsPerBoundary;
+  int _prerollMillis;
+
+  byte _patternSteps = 0;
+  byte _paletteSteps = 0;
+  bool _prepared = false;
+  uint32_t _dueMillis = 0;
+
+  bool _dropPending = false;
+  bool _drop = false;
+  uint32_t _dropDueMillis = 0;
+
+  bool isPending()
+  {
+    return _patternSteps || _paletteSteps;
+  }
+
+public:
+  /**
+   * @param beatsPerBoundary Beats between boundaries that changes snap to
+   * @param prerollMillis How long before the boundary to prepare the next pattern
+   */
+  BeatScheduler(byte beatsPerBoundary, int prerollMillis):
+    _beatsPerBoundary(beatsPerBoundary), _prerollMillis(prerollMillis)
+  {
+    // no-op
+  }
+
+  byte getBeatsPerBoundary()
+  {
+    return _beatsPerBoundary;
+  }
+
+  /**
+   * Queue more steps to the next pattern
+   * @param dueMillis Time of the next boundary, only used when nothing is queued yet
+   */
+  void schedulePattern(uint32_t dueMillis, byte steps = 1)
+  {
+    if (!isPending()) {
+      _dueMillis = dueMillis;
+    }
+    _patternSteps += steps;
+    _prepared = false;
+  }
+
+  /**
+   * Queue more steps to the next palette
+   * @param dueMillis Time of the next boundary, only used when nothing is queued yet
+   */
+  void schedulePalette(uint32_t dueMillis, byte steps = 1)
+  {
+    if (!isPending()) {
+      _dueMillis = dueMillis;
+    }
+    _paletteSteps += steps;
+  }
+
+  /**
+   * @param drop Whether to start or stop dropping
+   * @param ms Current time
+   * @param millisUntilBeat Time left until the next beat
+   * @param snapMillis Presses this close ahead of a beat wait for it
+   * @return True when the change applies immediately
+   */
+  bool scheduleDrop(bool drop, uint32_t ms, uint32_t millisUntilBeat, uint32_t snapMillis)
+  {
+    _drop = drop;
+    _dropPending = (millisUntilBeat < snapMillis);
+    _dropDueMillis = ms + millisUntilBeat;
+    return !_dropPending;
+  }
+
+  /**
+   * True once per queued pattern step, in time to prepare the upcoming pattern
+   */
+  bool shouldPrepare(uint32_t ms)
+  {
+    if (!_patternSteps || _prepared || (int32_t)(ms + _prerollMillis - _dueMillis) < 0) {
+      return false;
+    }
+    _prepared = true;
+    return true;
+  }
+
+  /**
+   * True when queued pattern and palette steps should be applied, see take*Steps()
+   */
+  bool isDue(uint32_t ms)
+  {
+    return isPending() && (int32_t)(ms - _dueMillis) >= 0;
+  }
+
+  bool isDropDue(uint32_t ms)
+  {
+    return _dropPending && (int32_t)(ms - _dropDueMillis) >= 0;
+  }
+
+  byte getPatternSteps()
+  {
+    return _patternSteps;
+  }
+
+  byte getPaletteSteps()
+  {
+    return _paletteSteps;
+  }
+
+  byte takePatternSteps()
+  {
+    byte steps = _patternSteps;
+    _patternSteps = 0;
+    _prepared = false;
+    return steps;
+  }
+
+  byte takePaletteSteps()
+  {
+    byte steps = _paletteSteps;
+    _paletteSteps = 0;
+    return steps;
+  }
+
+  bool takeDrop()
+  {
+    _dropPending = false;
+    return _drop;
+  }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef BeatSync_h
+#define BeatSync_h
+
+#include "Clock.h"
+
+#define SYNC_START_1 0xA5
+#define SYNC_START_2 0x5A
+#define SYNC_FRAME_SIZE 13 // including start bytes and checksum
+#define SYNC_INTERVAL_MILLIS 500
+#define SYNC_TIMEOUT_MILLIS 2000 // follow the local beat again when the leader goes quiet
+#define SYNC_MAX_SLEW_MILLIS 16 // max. phase correction per frame, avoids visible jumps
+#define SYNC_OFFSET_DECAY_MILLIS 6 // per frame, lets the link delay estimate follow clocks drifting apart by up to 1.2%
+
+/**
+ * Keeps the beat of several devices in sync over a serial link.
+ *
+ * The leader broadcasts its tempo, bar phase, pattern, palette and drop state.
+ * Frame: A5 5A beatLength(2) barPhase(2) leaderMillis(2) pattern palette flags reserved checksum,
+ * multi-byte values little endian, checksum is the XOR of everything after the start bytes.
+ * About 26 bytes per second at the default interval.
+ *
+ * Followers don't share a clock with the leader, and only read serial once per loop,
+ * so a frame may sit in the buffer for a while. They track the smallest difference
+ * between their clock and the leader's timestamp seen so far, which belongs to the
+ * frame with the least delay. Anything above it is extra delay on the current frame.
+ * Add the time it takes to transmit a frame, and that's the estimated link delay.
+ * Small phase errors are slewed out over several frames, large ones are jumped.
+ */
+class BeatSync {
+  uint32_t _baudRate;
+
+  byte _buffer[SYNC_FRAME_SIZE];
+  byte _received = 0;
+
+  bool _hasOffset = false;
+  uint16_t _minOffset = 0;
+  uint32_t _lastFrameMillis = 0;
+  bool _active = false;
+
+  // remote state, as of the last frame
+  uint16_t _beatLength = 500;
+  uint16_t _barPhase = 0;
+  uint16_t _elapsed = 0; // estimated time since the leader sampled the phase
+  byte _pattern = 0;
+  byte _palette = 0;
+  bool _dropping = false;
+
+  uint16_t readWord(byte offset)
+  {
+    return _buffer[offset] | (_buffer[offset + 1] << 8);
+  }
+
+  void writeWord(byte offset, uint16_t value)
+  {
+    _buffer[offset] = value & 0xFF;
+    _buffer[offset + 1] = value >> 8;
+  }
+
+  byte checksum()
+  {
+    byte sum = 0;
+    for (byte i = 2; i < SYNC_FRAME_SIZE - 1; i++) {
+      sum ^= _buffer[i];
+    }
+    return sum;
+  }
+
+  void handleFrame(uint32_t ms)
+  {
+    _beatLength = readWord(2);
+    _barPhase = readWord(4);
+    uint16_t leaderMillis = readWord(6);
+    _pattern = _buffer[8];
+    _palette = _buffer[9];
+    _dropping = _buffer[10] & 1;
+
+    uint16_t offset = (uint16_t)ms - leaderMillis;
+    if (!_hasOffset || (int16_t)(offset - _minOffset) < 0) {
+      _minOffset = offset;
+      _hasOffset = true;
+    }
+    uint16_t transmitMillis = SYNC_FRAME_SIZE * 10000UL / _baudRate;
+    _elapsed = (uint16_t)(offset - _minOffset) + transmitMillis;
+    _minOffset += SYNC_OFFSET_DECAY_MILLIS;
+
+    _lastFrameMillis = ms;
+    _active = true;
+  }
+
+public:
+  BeatSync(uint32_t baudRate): _baudRate(baudRate)
+  {
+    // no-op
+  }
+
+  /**
+   * Leader: Broadcast the current state
+   * @param barPhase Milliseconds into the current (four beat) bar
+   * @param pattern Pattern index including queued changes, which followers queue for their next boundary
+   * @param palette Palette index, like the pattern
+   */
+  void send(Stream &stream, uint16_t beatLength, uint16_t barPhase, byte pattern, byte palette, bool dropping)
+  {
+    _buffer[0] = SYNC_START_1;
+    _buffer[1] = SYNC_START_2;
+    writeWord(2, beatLength);
+    writeWord(4, barPhase);
+    writeWord(6, systemClock.millis());
+    _buffer[8] = pattern;
+    _buffer[9] = palette;
+    _buffer[10] = dropping ? 1 : 0;
+    _buffer[11] = 0;
+    _buffer[SYNC_FRAME_SIZE - 1] = checksum();
+    stream.write(_buffer, SYNC_FRAME_SIZE);
+  }
+
+  /**
+   * Follower: Feed a received byte
+   * @return True when a complete frame has been received
+   */
+  bool receive(byte b, uint32_t ms)
+  {
+    if ((_received == 0 && b != SYNC_START_1) || (_received == 1 && b != SYNC_START_2)) {
+      _received = (b == SYNC_START_1) ? 1 : 0;
+      return false;
+    }
+
+    _buffer[_received++] = b;
+    if (_received < SYNC_FRAME_SIZE) {
+      return false;
+    }
+
+    _received = 0;
+    if (_buffer[SYNC_FRAME_SIZE - 1] != checksum()) {
+      return false;
+    }
+    handleFrame(ms);
+    return true;
+  }
+
+  /**
+   * Whether a leader has been heard from recently
+   */
+  bool isActive(uint32_t ms)
+  {
+    if (_active && ms - _lastFrameMillis > SYNC_TIMEOUT_MILLIS) {
+      _active = false;
+    }
+    return _active;
+  }
+
+  uint16_t getBeatLength()
+  {
+    return _beatLength;
+  }
+
+  /**
+   * How far the local bar phase should move to match the leader's, as of the last frame.
+   * Limited to SYNC_MAX_SLEW_MILLIS, unless it's off by more than a beat.
+   * @param localBarPhase Milliseconds into the local bar when the frame was received
+   */
+  int32_t getCorrection(uint16_t localBarPhase)
+  {
+    int32_t barLength = (int32_t)_beatLength * 4;
+    int32_t error = ((int32_t)_barPhase + _elapsed - localBarPhase) % barLength;
+    if (error > barLength / 2) {
+      error -= barLength;
+    } else if (error < -barLength / 2) {
+      error += barLength;
+    }
+
+    if (abs(error) > _beatLength) {
+      return error;
+    }
+    return constrain(error / 2, -SYNC_MAX_SLEW_MILLIS, SYNC_MAX_SLEW_MILLIS);
+  }
+
+  byte getPattern()
+  {
+    return _pattern;
+  }
+
+  byte getPalette()
+  {
+    return _palette;
+  }
+
+  bool isDropping(uint32_t ms)
+  {
+    return isActive(ms) && _dropping;
+  }
+};
+
+#endif
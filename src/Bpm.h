@@ -1,4 +1,5 @@
 #include "Pattern.h"
+#include "FastRandom.h"
 
 /**
  * colored stripes pulsing at a defined Beats-Per-Minute (BPM)
@@ -18,13 +19,11 @@ class Bpm: public Pattern {
 
   void loopDefault(PatternState *state)
   {
-    int halfPoint = (int)state->ledsSize/2;
     uint8_t beat = beat8( bpm);
 
-    for( int i = 0; i <= halfPoint; i++) {
-      CRGB color = ColorFromPalette(*state->palette, gHue+(i*2), beat-gHue+(i*10));
-      state->leds[i] = color;
-      state->leds[state->ledsSize - i - 1] = color;
+    // Rendered from the scarf's ends to its centre, mapping mirrors both halves
+    for( int i = 0; i < state->ledsSize; i++) {
+      state->leds[i] = ColorFromPalette(*state->palette, gHue+(i*2), beat-gHue+(i*10));
     }
 
     // Add some glitter on parts the first beat (of four)
@@ -37,7 +36,7 @@ class Bpm: public Pattern {
           max = state->ledsSize - 1;
         }
         // state->leds[ min ] = firstColor;
-        state->leds[ random16(min,max) ] = CRGB::White;
+        state->leds[ fastRandom.between(min,max) ] = CRGB::White;
       }
     }
 
@@ -48,9 +47,14 @@ class Bpm: public Pattern {
   {
     // flash for the first beat (of four)
     if( beatProgress < 0.25 ) {
+      // One in three chance of lighting up, decided for 16 LEDs at a time
+      uint16_t lit = 0;
       for( int i = 0; i < state->ledsSize; i++) {
-        // One in three chance of lighting up
-        state->leds[i] = (random8(3) == 0) ? CRGB::White : CRGB::Black;
+        if ((i & 15) == 0) {
+          lit = fastRandom.mask(85);
+        }
+        state->leds[i] = (lit & 1) ? CRGB::White : CRGB::Black;
+        lit >>= 1;
       }
     } else {
       for( int i = 0; i < state->ledsSize; i++) {
@@ -60,6 +64,27 @@ class Bpm: public Pattern {
   }
 
   public:
+    bool isMapped()
+    {
+      return true;
+    }
+
+    /**
+     * Soften the glitter, but keep the drop strobe sharp
+     */
+    fract8 getBlur()
+    {
+      return isDropping ? 0 : 64;
+    }
+
+    /**
+     * Redrawn in full from the beat and time, only the glitter is per frame
+     */
+    bool isGovernable()
+    {
+      return true;
+    }
+
     void loopForState(PatternState *state, byte fade)
     {
       if(isDropping) {
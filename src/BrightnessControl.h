@@ -1,7 +1,6 @@
-#include <Bounce2.h>
+#include "ButtonEvents.h"
 
 class BrightnessControl {
-  Bounce button;
   int index = 0; // start with lowest brightness
   byte brightnesses[3] = {20,40,60}; // 0 to 100
   int pin;
@@ -12,23 +11,35 @@ public:
     // no-op
   }
 
-  void setup()
+  void setup(ButtonEvents &events)
   {
-    pinMode(pin, INPUT_PULLUP);
-    button.attach(pin);
-    button.interval(50);
+    events.attach(pin);
   }
 
-  void update()
+  void handle(const ButtonEvent &event)
   {
-    button.update();
-    if(button.fell()) {
+    if (event.pin == pin && event.pressed) {
       index = ((index + 1) % 3);
-      Serial.print("brightness: ");
+#ifdef DEBUG
+      Serial.print(F("brightness: "));
       Serial.println(index);
+#endif
     }
   }
 
+  /**
+   * @param level 0 to 2, from dim to bright
+   */
+  void setLevel(byte level)
+  {
+    index = level % 3;
+  }
+
+  byte getLevel()
+  {
+    return index;
+  }
+
   byte getBrightness()
   {
     return brightnesses[index];
@@ -0,0 +1,140 @@
+#ifndef ButtonEvents_h
+#define ButtonEvents_h
+
+#include "Clock.h"
+
+#define BUTTON_EVENTS_SIZE 8 // power of two
+#define BUTTON_EVENTS_MAX_PINS 4
+#define BUTTON_DEBOUNCE_MILLIS 50
+
+/**
+ * A debounced press or release, timestamped when it happened
+ * (rather than when loop() got around to it)
+ */
+struct ButtonEvent {
+  byte pin;
+  bool pressed;
+  uint32_t millis;
+};
+
+/**
+ * A ButtonEvent as queued by the interrupt, stamped in Clock::ticks()
+ */
+struct QueuedButtonEvent {
+  byte pin;
+  bool pressed;
+  uint16_t ticks;
+};
+
+/**
+ * Captures button presses through pin change interrupts,
+ * so timing doesn't depend on how long the last FastLED.show() took.
+ *
+ * Buttons are wired against ground (INPUT_PULLUP), so LOW means pressed.
+ * The first edge of a press is taken as is, further edges are ignored
+ * for BUTTON_DEBOUNCE_MILLIS (the contacts are still bouncing).
+ * If the level settled on something else by then, update() catches up.
+ *
+ * Events are kept in a single-producer (interrupt) single-consumer (loop)
+ * ring buffer, which doesn't need locking since byte writes are atomic.
+ * When it's full, new events are dropped.
+ *
+ * Events are stamped with Clock::ticks(), since millis() misses the time FastLED.show()
+ * keeps interrupts off. A press during show() is still only seen once show() has finished.
+ *
+ * Without pin change interrupts (non-AVR builds), update() polls the pins instead.
+ */
+class ButtonEvents {
+  volatile QueuedButtonEvent _events[BUTTON_EVENTS_SIZE];
+  volatile byte _head = 0;
+  volatile byte _tail = 0;
+
+  byte _pins[BUTTON_EVENTS_MAX_PINS];
+  bool _pressed[BUTTON_EVENTS_MAX_PINS];
+  uint32_t _changedMillis[BUTTON_EVENTS_MAX_PINS];
+  byte _numPins = 0;
+
+  void push(byte pin, bool pressed, uint16_t ticks)
+  {
+    byte next = (_head + 1) & (BUTTON_EVENTS_SIZE - 1);
+    if (next == _tail) {
+      return;
+    }
+    _events[_head].pin = pin;
+    _events[_head].pressed = pressed;
+    _events[_head].ticks = ticks;
+    _head = next;
+  }
+
+public:
+  /**
+   * Start capturing a button, up to BUTTON_EVENTS_MAX_PINS
+   */
+  void attach(byte pin)
+  {
+    if (_numPins >= BUTTON_EVENTS_MAX_PINS) {
+      return;
+    }
+
+    pinMode(pin, INPUT_PULLUP);
+    _pins[_numPins] = pin;
+    _pressed[_numPins] = (digitalRead(pin) == LOW);
+    _changedMillis[_numPins] = millis();
+    _numPins++;
+
+#ifdef __AVR__
+    *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+    PCIFR |= bit(digitalPinToPCICRbit(pin));
+    PCICR |= bit(digitalPinToPCICRbit(pin));
+#endif
+  }
+
+  /**
+   * Compare pin levels against the last known state. Called from the
+   * pin change interrupt, and from update() with interrupts disabled.
+   */
+  void handleInterrupt()
+  {
+    // millis() stands still while FastLED.show() has interrupts off, Timer1 doesn't
+    uint16_t ticks = Clock::ticks();
+    uint32_t ms = millis();
+    for (byte i = 0; i < _numPins; i++) {
+      bool pressed = (digitalRead(_pins[i]) == LOW);
+      if (pressed == _pressed[i] || ms - _changedMillis[i] < BUTTON_DEBOUNCE_MILLIS) {
+        continue;
+      }
+      _pressed[i] = pressed;
+      _changedMillis[i] = ms;
+      push(_pins[i], pressed, ticks);
+    }
+  }
+
+  /**
+   * Pick up levels which changed while debouncing (or poll without interrupts)
+   */
+  void update()
+  {
+    noInterrupts();
+    handleInterrupt();
+    interrupts();
+  }
+
+  /**
+   * Take the oldest event off the queue
+   * @return false when there are no events
+   */
+  bool pop(ButtonEvent &event)
+  {
+    if (_tail == _head) {
+      return false;
+    }
+    event.pin = _events[_tail].pin;
+    event.pressed = _events[_tail].pressed;
+    // Stamped with Timer1 in the interrupt, convert to the corrected clock
+    event.millis = systemClock.fromTicks(_events[_tail].ticks);
+    _tail = (_tail + 1) & (BUTTON_EVENTS_SIZE - 1);
+    return true;
+  }
+};
+
+#endif
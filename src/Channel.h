@@ -0,0 +1,136 @@
+#ifndef Channel_h
+#define Channel_h
+
+#include "PatternState.h"
+#include "OutputStage.h"
+
+// Patterns draw into a back buffer which is copied for transmission
+#if defined(OUTPUT_PIPELINE_THREADED) || defined(OUTPUT_GAMMA) || defined(OUTPUT_INTERPOLATION)
+  #define CHANNEL_FRONT_BUFFER
+#endif
+
+/**
+ * A single LED strip attached to a data pin, with its LED buffer
+ * and the PatternState that patterns draw through.
+ *
+ * Size and pin are template arguments, so the buffer is allocated statically
+ * and FastLED gets the compile-time pin it requires.
+ * Correction is a 0xRRGGBB colour correction (e.g. TypicalLEDStrip),
+ * since strips from different batches render colours differently.
+ */
+template<uint8_t PIN, uint16_t SIZE, uint32_t CORRECTION = UncorrectedColor>
+class Channel {
+  public:
+    static const uint8_t pin = PIN;
+    static const uint16_t size = SIZE;
+
+    /**
+     * Back buffer, patterns draw here
+     */
+    CRGB leds[SIZE];
+
+#ifdef CHANNEL_GUARD_BYTES
+    /**
+     * Never written, so the host soak harness can tell when something writes past leds
+     */
+    byte guard[CHANNEL_GUARD_BYTES];
+#endif
+
+#ifdef CHANNEL_FRONT_BUFFER
+    /**
+     * Front buffer, transmitted by FastLED
+     */
+    CRGB front[SIZE];
+#endif
+
+#ifdef OUTPUT_INTERPOLATION
+    /**
+     * Previous keyframe, blended towards the back buffer
+     */
+    CRGB previous[SIZE];
+#endif
+
+#ifdef OUTPUT_DITHER
+    byte ditherFrame = 0;
+#endif
+#ifdef OUTPUT_DITHER_ERROR
+    /**
+     * Fractions carried over between frames, see OutputStage
+     */
+    byte ditherError[SIZE * 3];
+#endif
+
+    /**
+     * Bitmap of lit LEDs, see PatternState::fadeActiveToBlackBy()
+     */
+    byte active[(SIZE + 7) / 8];
+
+    PatternState state;
+
+    /**
+     * Set up by FastLED, lets the channel transmit on its own
+     */
+    CLEDController *controller = 0;
+
+    Channel(): state(SIZE, leds, active)
+    {
+      // no-op
+    }
+
+    void setup()
+    {
+#ifdef CHANNEL_FRONT_BUFFER
+      memcpy(front, leds, sizeof(leds));
+      controller = &FastLED.addLeds<NEOPIXEL, PIN>(front, SIZE);
+#else
+      controller = &FastLED.addLeds<NEOPIXEL, PIN>(leds, SIZE);
+#endif
+
+#ifndef OUTPUT_GAMMA
+      // Without gamma there's no OutputStage pass, let FastLED correct while transmitting
+      controller->setCorrection(CRGB(CORRECTION));
+#endif
+    }
+
+    /**
+     * Keep the current frame before a pattern renders the next keyframe
+     */
+    void keyframe()
+    {
+#ifdef OUTPUT_INTERPOLATION
+      memcpy(previous, leds, sizeof(leds));
+#endif
+    }
+
+    /**
+     * Hand the back buffer over for transmission
+     * @param brightness Master brightness, only used with OUTPUT_GAMMA
+     * @param progress Blend from the previous keyframe, only used with OUTPUT_INTERPOLATION
+     */
+    void flip(byte brightness, fract8 progress)
+    {
+      // Without a front buffer FastLED transmits the back buffer as is
+#ifdef CHANNEL_FRONT_BUFFER
+#ifdef OUTPUT_INTERPOLATION
+      const CRGB *from = previous;
+#else
+      const CRGB *from = leds;
+      progress = 255;
+#endif
+
+#if defined(OUTPUT_GAMMA)
+#if defined(OUTPUT_DITHER_ERROR)
+      OutputStage::apply(from, leds, progress, front, SIZE, CORRECTION, brightness, ditherFrame++, ditherError);
+#elif defined(OUTPUT_DITHER)
+      OutputStage::apply(from, leds, progress, front, SIZE, CORRECTION, brightness, ditherFrame++, 0);
+#else
+      OutputStage::apply(from, leds, progress, front, SIZE, CORRECTION, brightness, 0, 0);
+#endif
+#else
+      OutputStage::interpolate(from, leds, progress, front, SIZE);
+#endif
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef ChannelList_h
+#define ChannelList_h
+
+#include "Channel.h"
+
+/**
+ * Compile-time list of all channels (LED strips) in the outfit, e.g.
+ *
+ *   ChannelList<
+ *     Channel<4, 120>, // scarf
+ *     Channel<2, 29>   // hat
+ *   > channels;
+ *
+ * Each channel is stored inline, so only declared channels take up SRAM.
+ * The list recurses through inheritance, the empty terminator costs no bytes.
+ */
+template<typename... Channels>
+class ChannelList;
+
+template<>
+class ChannelList<> {
+  public:
+    static const byte count = 0;
+    static const uint16_t maxSize = 0;
+    static const uint16_t totalSize = 0;
+
+    void setup()
+    {
+    }
+
+    void keyframe(byte states)
+    {
+    }
+
+    void flip(byte states, byte brightness, fract8 progress)
+    {
+    }
+
+    void show(byte states, byte brightness)
+    {
+    }
+
+    PatternState *getState(byte index)
+    {
+      return 0;
+    }
+};
+
+template<typename Head, typename... Tail>
+class ChannelList<Head, Tail...>: public ChannelList<Tail...> {
+  typedef ChannelList<Tail...> Rest;
+
+  Head _channel;
+
+  // States are passed around as byte bitmasks (e.g. followingStates in main.cpp)
+  static_assert(sizeof...(Tail) < 8, "ChannelList supports up to 8 channels");
+
+  public:
+    static const byte count = 1 + Rest::count;
+    static const uint16_t maxSize = Head::size > Rest::maxSize ? Head::size : Rest::maxSize;
+    static const uint16_t totalSize = Head::size + Rest::totalSize;
+    static const byte all = (1 << count) - 1; // bitmask of all channels
+
+    /**
+     * Register all channels with FastLED
+     */
+    void setup()
+    {
+      _channel.setup();
+      Rest::setup();
+    }
+
+    /**
+     * Hand back buffers over for transmission, see OutputPipeline
+     * @param states Bitmask of channels, lowest bit for the first
+     */
+    void flip(byte states, byte brightness, fract8 progress)
+    {
+      if (states & 1) {
+        _channel.flip(brightness, progress);
+      }
+      Rest::flip(states >> 1, brightness, progress);
+    }
+
+    /**
+     * Keep the current frames before rendering the next keyframe
+     * @param states Bitmask of channels, lowest bit for the first
+     */
+    void keyframe(byte states)
+    {
+      if (states & 1) {
+        _channel.keyframe();
+      }
+      Rest::keyframe(states >> 1);
+    }
+
+    /**
+     * Transmit some channels only, rather than all of them through FastLED.show()
+     * @param states Bitmask of channels, lowest bit for the first
+     */
+    void show(byte states, byte brightness)
+    {
+      if (states & 1) {
+        _channel.controller->showLeds(brightness);
+      }
+      Rest::show(states >> 1, brightness);
+    }
+
+    PatternState *getState(byte index)
+    {
+      if (index == 0) {
+        return &_channel.state;
+      }
+      return Rest::getState(index - 1);
+    }
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef Clock_h
+#define Clock_h
+
+#define CLOCK_TICK_MICROS 16 // Timer1 at 16MHz / 256
+
+/**
+ * millis(), corrected for time lost while FastLED.show() disables interrupts.
+ *
+ * On the AVR, millis() counts Timer0 overflow interrupts. WS2812 output keeps interrupts
+ * off for about 30us per LED, and only one overflow can be pending meanwhile, so every
+ * show() of more than a millisecond loses ticks. The beat then drifts against the music,
+ * in proportion to frame rate and LED count.
+ *
+ * Timer1 keeps counting in hardware regardless of interrupts. It's set up to run freely
+ * (which costs PWM on pins 9 and 10), and each update() compares how far it got with how
+ * far millis() got. Whatever millis() missed is added to an offset, which only ever grows,
+ * so the corrected clock is monotonic. Since this measures rather than estimates,
+ * it doesn't double count when the FastLED version in use corrects for some of it already.
+ * Timer1 wraps after about a second, so update() needs to be called at least that often.
+ *
+ * Everywhere else, millis() is accurate and gets passed through.
+ */
+class Clock {
+  uint32_t _offset = 0; // milliseconds missed by millis()
+  uint32_t _millis = 0; // corrected, as of the last update()
+  uint16_t _lastTicks = 0; // as of the last update(), see ticks()
+
+#ifdef __AVR__
+  uint32_t _lastRawMillis = 0;
+  int32_t _errorMicros = 0; // Timer1 minus millis(), not yet added to the offset
+#endif
+
+public:
+  void setup()
+  {
+#ifdef __AVR__
+    TCCR1A = 0;
+    TCCR1B = _BV(CS12); // normal mode, prescaler 256
+    _lastRawMillis = ::millis();
+#endif
+    _lastTicks = ticks();
+    _millis = ::millis();
+  }
+
+  /**
+   * Free-running count in CLOCK_TICK_MICROS, which keeps going while interrupts are off.
+   * Safe to call from interrupts, e.g. to timestamp button presses.
+   */
+  static uint16_t ticks()
+  {
+#ifdef __AVR__
+    return TCNT1;
+#else
+    return ::micros() / CLOCK_TICK_MICROS;
+#endif
+  }
+
+  /**
+   * Measure time lost since the last call, once per loop
+   * @return Corrected milliseconds
+   */
+  uint32_t update()
+  {
+#ifdef __AVR__
+    noInterrupts();
+    uint16_t ticks = TCNT1;
+    uint32_t rawMillis = ::millis();
+    interrupts();
+
+    _errorMicros += (int32_t)(uint16_t)(ticks - _lastTicks) * CLOCK_TICK_MICROS
+      - (int32_t)(rawMillis - _lastRawMillis) * 1000;
+    _lastTicks = ticks;
+    _lastRawMillis = rawMillis;
+    // millis() only counts whole ticks, so small negative errors are normal
+    if (_errorMicros >= 1000) {
+      _offset += _errorMicros / 1000;
+      _errorMicros %= 1000;
+    }
+#else
+    _lastTicks = ticks();
+#endif
+    _millis = ::millis() + _offset;
+    return _millis;
+  }
+
+  /**
+   * Corrected milliseconds, as of the last update().
+   * Stable within a frame, so everything rendered in it agrees on the time.
+   */
+  uint32_t millis()
+  {
+    return _millis;
+  }
+
+  /**
+   * Convert a ticks() reading (e.g. taken in an interrupt) to corrected milliseconds.
+   * Readings up to half a Timer1 wrap (about half a second) either side of the last update() convert right.
+   */
+  uint32_t fromTicks(uint16_t ticks)
+  {
+    uint16_t after = ticks - _lastTicks;
+    if (after < 0x8000) {
+      return _millis + (uint32_t)after * CLOCK_TICK_MICROS / 1000;
+    }
+    return _millis - (uint32_t)(uint16_t)(_lastTicks - ticks) * CLOCK_TICK_MICROS / 1000;
+  }
+
+  /**
+   * Milliseconds lost by millis() since startup, for tuning and debugging
+   */
+  uint32_t getLostMillis()
+  {
+    return _offset;
+  }
+};
+
+/**
+ * Shared by controls and patterns, see main.cpp
+ */
+Clock systemClock;
+
+#endif
@@ -1,4 +1,5 @@
 #include "Pattern.h"
+#include "FastRandom.h"
 
 /**
  * random colored speckles that blink in and fade smoothly
@@ -11,16 +12,35 @@ class Confetti: public Pattern {
   uint8_t gHue = 0;
 
   public:
+    void setup()
+    {
+      markAllActive();
+    }
+
+    /**
+     * Fades and speckles follow the time, so fewer frames only make the steps coarser
+     */
+    bool isGovernable()
+    {
+      return true;
+    }
+
     void loopForState(PatternState *state, byte fade)
     {
-      fadeToBlackBy( state->leds, state->ledsSize, 10);
-      int pos = random16(state->ledsSize);
-      if (isDropping) {
-        // Colorful
-        state->leds[pos] += CHSV( gHue + random8(64), 200, 255);
-      } else {
-        // Default Palette
-        state->leds[pos] += ColorFromPalette(*state->palette, gHue, 255);
+      int length = getFrameLength();
+      uint16_t elapsed = state->fadeActiveToBlackFor(10, length, presentMillis);
+      // A speckle per frame length, rounding the rest up or down at random so it evens out
+      byte speckles = elapsed / length + (fastRandom.below(length) < elapsed % length);
+      for (byte i = 0; i < speckles; i++) {
+        int pos = fastRandom.below(state->ledsSize);
+        if (isDropping) {
+          // Colorful
+          state->leds[pos] += CHSV( gHue + (fastRandom.next() & 63), 200, 255);
+        } else {
+          // Default Palette
+          state->leds[pos] += ColorFromPalette(*state->palette, gHue, 255);
+        }
+        state->markActive(pos);
       }
 
       EVERY_N_MILLISECONDS( 20 ) { gHue++; }
@@ -1,11 +1,11 @@
-#include <Bounce2.h>
+#include "ButtonEvents.h"
 
 class DropControl {
-  Bounce _button;
   int pin;
-  unsigned long _millisAtPress = 0;
-  int _longPressMillis = 1000;
-  bool _wasLongPress = false;
+  bool _pressed = false;
+  bool _cancelled = false; // ignore the release of the current press
+  bool _fell = false;
+  bool _rose = false;
 
 public:
   DropControl(int _pin): pin(_pin)
@@ -13,45 +13,61 @@ public:
     // no-op
   }
 
-  void setup()
+  void setup(ButtonEvents &events)
   {
-    pinMode(pin, INPUT_PULLUP);
-    _button.attach(pin);
-    _button.interval(50);
+    events.attach(pin);
   }
 
+  /**
+   * Start a new loop, forgetting the previous loop's presses
+   */
   void update()
   {
-    _button.update();
-    if (_button.fell()) {
-      _millisAtPress = millis();
+    _fell = false;
+    _rose = false;
+  }
+
+  void handle(const ButtonEvent &event)
+  {
+    if (event.pin != pin) {
+      return;
     }
-    if (_button.rose()) {
-      _wasLongPress = ((millis() - _millisAtPress) > _longPressMillis);
-      _millisAtPress = 0;
+    _pressed = event.pressed;
+    if (event.pressed) {
+      _fell = true;
+      _cancelled = false;
+    } else if (_cancelled) {
+      _cancelled = false;
+    } else {
+      _rose = true;
     }
   }
 
   bool fell()
   {
-    return _button.fell();
+    return _fell;
   }
 
   bool rose()
   {
-    return _button.rose();
+    return _rose;
   }
 
-  int read()
+  /**
+   * Forget the current press, e.g. when it's part of a chord.
+   * It won't count as fell(), and its release won't count as rose().
+   */
+  void cancel()
   {
-    return _button.read();
+    _fell = false;
+    _cancelled = _pressed;
   }
 
   /**
-   * Was the last press a long one?
+   * Button level, LOW while pressed
    */
-  bool wasLongPress()
+  int read()
   {
-    return _wasLongPress;
+    return _pressed ? LOW : HIGH;
   }
 };
@@ -0,0 +1,94 @@
+#ifndef FastRandom_h
+#define FastRandom_h
+
+#define FAST_RANDOM_DEFAULT_SEED 0xACE1 // used instead of 0, which xorshift can't leave
+
+/**
+ * Cheap, reproducible random numbers for sparkle and strobe effects.
+ *
+ * A 16 bit xorshift, which only needs shifts and XORs on the AVR.
+ * The period (65535) matches FastLED's random16().
+ * Since every call yields 16 random bits, mask() can decide for 16 LEDs at once,
+ * rather than calling random8() per LED.
+ *
+ * The seed can be logged and fed back in through seed(),
+ * to replay the exact same sparkles (e.g. when chasing a glitch).
+ */
+class FastRandom {
+  uint16_t _state = FAST_RANDOM_DEFAULT_SEED;
+  uint16_t _seed = FAST_RANDOM_DEFAULT_SEED;
+
+public:
+  void seed(uint16_t seed)
+  {
+    _seed = seed ? seed : FAST_RANDOM_DEFAULT_SEED;
+    _state = _seed;
+  }
+
+  uint16_t getSeed()
+  {
+    return _seed;
+  }
+
+  /**
+   * 16 random bits
+   */
+  uint16_t next()
+  {
+    _state ^= _state << 7;
+    _state ^= _state >> 9;
+    _state ^= _state << 8;
+    return _state;
+  }
+
+  /**
+   * @return 0 to limit - 1
+   */
+  uint16_t below(uint16_t limit)
+  {
+    return ((uint32_t)next() * limit) >> 16;
+  }
+
+  /**
+   * @return min to max - 1, like random16(min, max)
+   */
+  uint16_t between(uint16_t min, uint16_t max)
+  {
+    return min + below(max - min);
+  }
+
+  /**
+   * 16 bits, each set with a chance of probability / 256.
+   *
+   * Compares a random byte against probability for all 16 bits in parallel:
+   * Going from the lowest set bit of probability to the highest,
+   * each random word ORs in (probability bit set) or ANDs in (not set).
+   * Takes one word per bit from the lowest set one, e.g. two for 64 (one in four).
+   */
+  uint16_t mask(uint8_t probability)
+  {
+    if (!probability) {
+      return 0;
+    }
+    byte bit = 0;
+    while (!(probability & (1 << bit))) {
+      bit++;
+    }
+    uint16_t result = 0;
+    for (; bit < 8; bit++) {
+      if (probability & (1 << bit)) {
+        result |= next();
+      } else {
+        result &= next();
+      }
+    }
+    return result;
+  }
+};
+
+/**
+ * Shared by all patterns, so a single seed reproduces a whole session
+ */
+FastRandom fastRandom;
+
+#endif
@@ -0,0 +1,76 @@
+#include "Pattern.h"
+#include "FastRandom.h"
+
+#define FIRE_COOLING 55 // more cooling means shorter flames
+#define FIRE_SPARKING 120 // chance (out of 255) of a new spark per frame
+#define FIRE_SPARK_ZONE 7 // LEDs at the bottom where sparks ignite
+
+/**
+ * Flames rising from the scarf ends towards the neck, after Mark Kriegsman's Fire2012.
+ *
+ * Keeps one byte of heat per LED in the logical strip's activation buffer.
+ * Cooling, diffusion and colouring happen in a single pass from the top down:
+ * each cell takes the heat of the two cells below it, which haven't been
+ * updated yet, so no second buffer is needed. Divisions are replaced with
+ * multiply-and-shift, and the random cooling amounts come two at a time
+ * from FastRandom, so 120+ LEDs render well within a 60 fps frame on the Nano.
+ *
+ * Heat is mapped through the current palette (lava looks most like fire).
+ * Drop mode adds a burst of sparks on every beat.
+ */
+class Fire: public Pattern {
+
+  void spark(byte *heat, uint16_t size, uint16_t zone)
+  {
+    uint16_t pos = fastRandom.below(min(zone, size));
+    heat[pos] = qadd8(heat[pos], 160 + (fastRandom.next() & 0x5F));
+  }
+
+  public:
+    bool isMapped()
+    {
+      return true;
+    }
+
+    void loopForState(PatternState *state, byte fade)
+    {
+      byte *heat = state->getActivation();
+      uint16_t size = state->ledsSize;
+
+      if ((fastRandom.next() & 0xFF) < FIRE_SPARKING) {
+        spark(heat, size, FIRE_SPARK_ZONE);
+      }
+      if (isDropping && onBeat) {
+        for (byte i = 0; i < 4; i++) {
+          spark(heat, size, size / 4);
+        }
+      }
+
+      byte cooling = (FIRE_COOLING * 10) / size + 2;
+      uint16_t noise = 0;
+      byte noiseBytes = 0;
+      for (uint16_t i = size; i-- > 0;) {
+        uint16_t h = heat[i];
+        if (i >= 2) {
+          // (below + 2 * two below) / 3
+          h = ((uint16_t)(heat[i - 1] + 2 * heat[i - 2]) * 85) >> 8;
+        }
+        if (!noiseBytes) {
+          noise = fastRandom.next();
+          noiseBytes = 2;
+        }
+        h = qsub8(h, scale8(noise & 0xFF, cooling));
+        noise >>= 8;
+        noiseBytes--;
+        heat[i] = h;
+
+        // Scale to 240, since the palette wraps around from its last entry back to its first
+        state->leds[i] = ColorFromPalette(*state->palette, scale8(h, 240));
+      }
+    }
+
+    int getFrameLength()
+    {
+      return 1000 / 60;
+    }
+};
@@ -0,0 +1,123 @@
+#ifndef FrameGovernor_h
+#define FrameGovernor_h
+
+#define GOVERNOR_BLOCKS 32 // runs of LEDs compared between frames, over all channels
+#define GOVERNOR_STATIC_CHANGE 2048 // frames changing the brightness of all blocks by this much or less are near-static
+#define GOVERNOR_STEP_MILLIS 4 // slow down by this much per near-static frame
+#define GOVERNOR_MOTION_MAGNITUDE 20 // see AccellerationControl::getAdjustedMagnitude()
+
+/**
+ * Lowers the frame rate while patterns are near-static, to save CPU and show() time.
+ *
+ * After each frame, the LEDs of all rendered channels are split into blocks,
+ * and each block's brightness (r + g + b of its LEDs) is compared with the previous frame's.
+ * While the changes add up to GOVERNOR_STATIC_CHANGE or less, the frame length grows
+ * step by step up to maxLength. Once a frame changes more, it drops back to the pattern's own
+ * frame length (snapping back at once, since a late frame is more visible than a slow one).
+ * Patterns opting in draw and fade by the time rather than per frame, so longer frames
+ * change more: the rate settles where each frame is a small step, e.g. for slow fades
+ * and sparse dots, while busy patterns keep the full rate.
+ * Drops and dancing (accelerometer motion) always run at full rate.
+ *
+ * Summing blocks rather than keeping a copy of the frame costs two bytes of SRAM per block,
+ * and one pass over the LEDs per frame. Only patterns that opt in through
+ * Pattern::isGovernable() should be slowed down, see apply().
+ */
+class FrameGovernor {
+  int _maxLength;
+  int _length = 0; // frame length to stretch the pattern's to, 0 for no stretching
+  uint16_t _sums[GOVERNOR_BLOCKS];
+  uint16_t _change = 0;
+  int _magnitude = 0;
+  bool _dropping = false;
+
+public:
+  /**
+   * @param maxLength Longest frame length (in milliseconds) to slow down to
+   */
+  FrameGovernor(int maxLength): _maxLength(maxLength)
+  {
+    // no-op
+  }
+
+  /**
+   * Compare a rendered frame with the previous one
+   * @param channels See ChannelList
+   * @param states Bitmask of the channels just rendered, the others are left out
+   * @param patternLength The pattern's own frame length, the shortest the governor goes
+   */
+  template<typename ChannelsT>
+  void measure(ChannelsT &channels, byte states, int patternLength)
+  {
+    uint16_t sums[GOVERNOR_BLOCKS];
+    memset(sums, 0, sizeof(sums));
+    uint16_t offset = 0; // of the channel, over all channels
+    for (byte s = 0; s < ChannelsT::count; s++) {
+      PatternState *state = channels.getState(s);
+      if (states & (1 << s)) {
+        // Step through the blocks without a division per LED
+        uint32_t position = (uint32_t)offset * GOVERNOR_BLOCKS;
+        byte block = position / ChannelsT::totalSize;
+        uint16_t fraction = position % ChannelsT::totalSize;
+        for (uint16_t i = 0; i < state->ledsSize; i++) {
+          const CRGB &led = state->leds[i];
+          sums[block] += led.r + led.g + led.b;
+          fraction += GOVERNOR_BLOCKS;
+          while (fraction >= ChannelsT::totalSize) {
+            fraction -= ChannelsT::totalSize;
+            block++;
+          }
+        }
+      }
+      offset += state->ledsSize;
+    }
+
+    uint32_t change = 0;
+    for (byte i = 0; i < GOVERNOR_BLOCKS; i++) {
+      change += sums[i] > _sums[i] ? sums[i] - _sums[i] : _sums[i] - sums[i];
+      _sums[i] = sums[i];
+    }
+    _change = min(change, (uint32_t)0xFFFF);
+
+    if (_dropping || _magnitude >= GOVERNOR_MOTION_MAGNITUDE || change > GOVERNOR_STATIC_CHANGE) {
+      _length = 0;
+    } else {
+      _length = min(max(_length, patternLength) + GOVERNOR_STEP_MILLIS, _maxLength);
+    }
+  }
+
+  /**
+   * @return Brightness change of the last measured frame, see GOVERNOR_STATIC_CHANGE
+   */
+  uint16_t getChange()
+  {
+    return _change;
+  }
+
+  /**
+   * @param magnitude See AccellerationControl::getAdjustedMagnitude()
+   */
+  void setMotion(int magnitude)
+  {
+    _magnitude = magnitude;
+  }
+
+  void setIsDropping(bool dropping)
+  {
+    if (dropping && !_dropping) {
+      _length = 0;
+    }
+    _dropping = dropping;
+  }
+
+  /**
+   * @param length Frame length the pattern asks for
+   * @return Frame length to render at
+   */
+  int apply(int length)
+  {
+    return max(length, _length);
+  }
+};
+
+#endif
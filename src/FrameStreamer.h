@@ -0,0 +1,205 @@
+#ifndef FrameStreamer_h
+#define FrameStreamer_h
+
+#define STREAM_START_1 0xA7
+#define STREAM_START_2 0x7A
+#define STREAM_OP_SKIP 0x00 // followed by nothing, LEDs unchanged
+#define STREAM_OP_RUN 0x40 // followed by one colour for all LEDs
+#define STREAM_OP_RAW 0x80 // followed by one colour per LED
+#define STREAM_OP_END 0xC0
+#define STREAM_MAX_LENGTH 64
+#define STREAM_KEYFRAME_INTERVAL 30 // frames, every one of these sends all LEDs
+
+/**
+ * Streams rendered frames over serial, so patterns can be tuned
+ * on a laptop with scripts/frame_viewer.py rather than in a dark room.
+ *
+ * All channels are sent back to back, as a delta against what has been sent before:
+ * Unchanged LEDs are skipped, and runs of a single colour are sent once.
+ * Every STREAM_KEYFRAME_INTERVAL frames, nothing is skipped, so the viewer
+ * recovers from lost or misread frames.
+ * Frame: A7 7A pattern encodeMicros(2) ops... C0, with encodeMicros (little endian)
+ * being the time spent encoding and writing the previous frame. Each op is a byte with the
+ * type in the top two bits, and the number of LEDs minus one in the rest.
+ *
+ * Encoding happens a few bytes at a time, whenever the serial buffer has space,
+ * so it never blocks the frame loop. When the link can't keep up, a streamed frame
+ * may mix LEDs from consecutive renders. The viewer still ends up with exactly what
+ * has been sent, since the delta is against that rather than the previous render.
+ * Costs a copy of all LEDs in SRAM, so it's opt-in through FRAME_STREAM.
+ */
+template<typename ChannelsT>
+class FrameStreamer {
+  ChannelsT &_channels;
+
+  /**
+   * What the viewer currently shows, all channels back to back
+   */
+  CRGB _sent[ChannelsT::totalSize];
+
+  byte _pattern = 0;
+  bool _pending = false; // a frame has been shown since the last one was streamed
+  bool _streaming = false;
+  bool _keyframe = false; // the current frame doesn't skip any LEDs
+  byte _frames = 0; // since the last keyframe
+  byte _channel = 0;
+  uint16_t _index = 0; // within the channel
+  uint16_t _offset = 0; // of the channel within _sent
+  byte _literals = 0; // LEDs left in the current raw op
+
+  byte _buffer[5];
+  byte _buffered = 0;
+  byte _written = 0;
+
+  uint32_t _encodeMicros = 0;
+  uint16_t _lastEncodeMicros = 0;
+
+  /**
+   * Find the longest op starting at the current LED, and buffer its header.
+   * Raw LEDs are encoded one at a time, so they're picked up by encodeLiteral().
+   */
+  void encodeOp(PatternState *state)
+  {
+    CRGB *leds = state->leds;
+    uint16_t remaining = min(state->ledsSize - _index, STREAM_MAX_LENGTH);
+    CRGB *sent = _sent + _offset;
+    uint16_t i = _index;
+
+    byte length = 1;
+    if (!_keyframe && leds[i] == sent[i]) {
+      while (length < remaining && leds[i + length] == sent[i + length]) {
+        length++;
+      }
+      _buffer[0] = STREAM_OP_SKIP | (length - 1);
+      _buffered = 1;
+    } else if (remaining > 1 && leds[i + 1] == leds[i]) {
+      while (length < remaining && leds[i + length] == leds[i]) {
+        length++;
+      }
+      _buffer[0] = STREAM_OP_RUN | (length - 1);
+      _buffer[1] = leds[i].r;
+      _buffer[2] = leds[i].g;
+      _buffer[3] = leds[i].b;
+      _buffered = 4;
+      for (byte j = 0; j < length; j++) {
+        sent[i + j] = leds[i];
+      }
+    } else {
+      // Changed LEDs up to the next unchanged one or run
+      while (length < remaining
+        && (_keyframe || leds[i + length] != sent[i + length])
+        && !(length + 1 < remaining && leds[i + length + 1] == leds[i + length])
+      ) {
+        length++;
+      }
+      _buffer[0] = STREAM_OP_RAW | (length - 1);
+      _buffered = 1;
+      _literals = length;
+      return;
+    }
+    _index += length;
+  }
+
+  void encodeLiteral(PatternState *state)
+  {
+    CRGB led = state->leds[_index];
+    _sent[_offset + _index] = led;
+    _buffer[0] = led.r;
+    _buffer[1] = led.g;
+    _buffer[2] = led.b;
+    _buffered = 3;
+    _index++;
+    _literals--;
+  }
+
+  /**
+   * Buffer the next few bytes of the current frame
+   */
+  void encode()
+  {
+    _written = 0;
+    if (!_streaming) {
+      _buffer[0] = STREAM_START_1;
+      _buffer[1] = STREAM_START_2;
+      _buffer[2] = _pattern;
+      _buffer[3] = _lastEncodeMicros & 0xFF;
+      _buffer[4] = _lastEncodeMicros >> 8;
+      _buffered = 5;
+      _streaming = true;
+      _pending = false;
+      _keyframe = (_frames == 0);
+      _frames = (_frames + 1) % STREAM_KEYFRAME_INTERVAL;
+      _channel = 0;
+      _index = 0;
+      _offset = 0;
+      _literals = 0;
+      _encodeMicros = 0;
+      return;
+    }
+
+    PatternState *state = _channels.getState(_channel);
+    if (_literals) {
+      encodeLiteral(state);
+      return;
+    }
+    while (_index >= state->ledsSize) {
+      _offset += state->ledsSize;
+      _index = 0;
+      _channel++;
+      if (_channel >= ChannelsT::count) {
+        _buffer[0] = STREAM_OP_END;
+        _buffered = 1;
+        _streaming = false;
+        _lastEncodeMicros = min(_encodeMicros, 0xFFFFUL);
+        return;
+      }
+      state = _channels.getState(_channel);
+    }
+    encodeOp(state);
+  }
+
+  public:
+    FrameStreamer(ChannelsT &channels): _channels(channels)
+    {
+      // Black, like the LEDs before the first frame
+      fill_solid(_sent, ChannelsT::totalSize, CRGB::Black);
+    }
+
+    /**
+     * Call after a frame has been shown
+     */
+    void frameShown(byte pattern)
+    {
+      _pattern = pattern;
+      _pending = true;
+    }
+
+    /**
+     * Send as much of the current frame as fits into the serial buffer, without blocking.
+     * Call between renders.
+     */
+    void update(HardwareSerial &serial)
+    {
+      if (!_streaming && !_pending && _written == _buffered) {
+        return;
+      }
+
+      uint32_t start = micros();
+      int space = serial.availableForWrite();
+      while (space > 0) {
+        if (_written == _buffered) {
+          if (!_streaming && !_pending) {
+            break;
+          }
+          encode();
+        }
+        serial.write(_buffer[_written++]);
+        space--;
+      }
+      if (_streaming) {
+        _encodeMicros += micros() - start;
+      }
+    }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef GestureControl_h
+#define GestureControl_h
+
+#include "ButtonEvents.h"
+
+#define GESTURE_SAMPLE_MILLIS 20 // 50Hz, fast enough to catch the peaks of a shake
+#define GESTURE_MAX_EVENTS 4
+
+/**
+ * Recognises a few gestures from accelerometer samples,
+ * and turns them into the same events the buttons produce:
+ *
+ *  - Double shake: Press the mode button (next pattern)
+ *  - Sustained tilt: Long-press the mode button (next palette)
+ *  - Jump (single strong impulse): Hold the drop button for a while
+ *
+ * Everything is integer maths on raw ADC readings.
+ * Each axis is low-pass filtered to get gravity (fixed point, 4 fractional bits),
+ * the rest is treated as motion. A much slower baseline of gravity
+ * tracks the resting orientation, so tilt is measured relative to how the scarf is worn.
+ *
+ * Thresholds are in ADC counts, roughly 70 counts per g on an ADXL335 at 5V.
+ */
+class GestureControl {
+  static const int shakeThreshold = 120; // min. motion (sum over axes) to count as a peak
+  static const int jumpThreshold = 250; // min. motion for a single peak to count as a jump
+  static const int peakRefractoryMillis = 150; // ignore further samples of the same peak
+  static const int doubleShakeMillis = 600; // max. time between two peaks of a double shake
+  static const int tiltThreshold = 60; // min. gravity change (sum over axes) from the baseline
+  static const int tiltMillis = 1500;
+  static const int dropMillis = 2000; // how long a jump holds the drop button
+  static const int longPressMillis = 600; // longer than ModeControl's long press
+
+  byte modePin;
+  byte dropPin;
+
+  int gravity[3]; // << 4
+  int baseline[3]; // << 4
+  byte baselineCounter = 0;
+  bool calibrated = false;
+
+  uint32_t peakMillis = 0; // last peak, 0 when not waiting for a second one
+  int peakMotion = 0;
+  uint32_t tiltStartMillis = 0; // 0 when not tilted
+  bool tiltTriggered = false;
+  uint32_t dropReleaseMillis = 0; // 0 when not holding the drop
+
+  ButtonEvent events[GESTURE_MAX_EVENTS];
+  byte numEvents = 0;
+
+  void emit(byte pin, bool pressed, uint32_t ms)
+  {
+    if (numEvents >= GESTURE_MAX_EVENTS) {
+      return;
+    }
+    events[numEvents].pin = pin;
+    events[numEvents].pressed = pressed;
+    events[numEvents].millis = ms;
+    numEvents++;
+  }
+
+  void updateShake(int motion, uint32_t ms)
+  {
+    // A single peak with nothing following it
+    if (peakMillis && ms - peakMillis > doubleShakeMillis) {
+      if (peakMotion > jumpThreshold && !dropReleaseMillis) {
+        emit(dropPin, true, peakMillis);
+        dropReleaseMillis = peakMillis + dropMillis;
+      }
+      peakMillis = 0;
+    }
+
+    if (motion < shakeThreshold) {
+      return;
+    }
+
+    if (!peakMillis) {
+      peakMillis = ms;
+      peakMotion = motion;
+    } else if (ms - peakMillis > peakRefractoryMillis) {
+      // Stamped together, since peaks further apart than ModeControl's long press would change the palette
+      emit(modePin, true, ms);
+      emit(modePin, false, ms);
+      peakMillis = 0;
+    } else if (motion > peakMotion) {
+      peakMotion = motion;
+    }
+  }
+
+  void updateTilt(int deviation, uint32_t ms)
+  {
+    if (deviation < tiltThreshold / 2) {
+      tiltStartMillis = 0;
+      tiltTriggered = false;
+      return;
+    }
+
+    if (deviation < tiltThreshold || tiltTriggered) {
+      return;
+    }
+
+    if (!tiltStartMillis) {
+      tiltStartMillis = ms;
+    } else if (ms - tiltStartMillis > tiltMillis) {
+      // Pretend the button has been held down for long enough
+      emit(modePin, true, ms - longPressMillis);
+      emit(modePin, false, ms);
+      tiltTriggered = true;
+    }
+  }
+
+public:
+  GestureControl(byte _modePin, byte _dropPin): modePin(_modePin), dropPin(_dropPin)
+  {
+    // no-op
+  }
+
+  /**
+   * Feed a sample, every GESTURE_SAMPLE_MILLIS
+   */
+  void update(int x, int y, int z, uint32_t ms)
+  {
+    int sample[3] = {x, y, z};
+
+    if (!calibrated) {
+      for (byte i = 0; i < 3; i++) {
+        gravity[i] = sample[i] << 4;
+        baseline[i] = gravity[i];
+      }
+      calibrated = true;
+      return;
+    }
+
+    int motion = 0;
+    int deviation = 0;
+    bool tilted = tiltStartMillis || tiltTriggered;
+    baselineCounter++;
+    for (byte i = 0; i < 3; i++) {
+      gravity[i] += ((sample[i] << 4) - gravity[i]) >> 3;
+      motion += abs(sample[i] - (gravity[i] >> 4));
+      deviation += abs(gravity[i] - baseline[i]) >> 4;
+
+      // Follow slow changes in how the scarf is worn, but not a deliberate tilt
+      if (!tilted && (baselineCounter & 7) == 0) {
+        baseline[i] += (gravity[i] - baseline[i]) >> 4;
+      }
+    }
+
+    updateShake(motion, ms);
+    updateTilt(deviation, ms);
+
+    if (dropReleaseMillis && (int32_t)(ms - dropReleaseMillis) >= 0) {
+      emit(dropPin, false, ms);
+      dropReleaseMillis = 0;
+    }
+  }
+
+  /**
+   * Take the oldest gesture event, see ButtonEvents::pop()
+   */
+  bool pop(ButtonEvent &event)
+  {
+    if (!numEvents) {
+      return false;
+    }
+    event = events[0];
+    numEvents--;
+    for (byte i = 0; i < numEvents; i++) {
+      events[i] = events[i + 1];
+    }
+    return true;
+  }
+};
+
+#endif
@@ -23,7 +23,7 @@ class Heartbeat: public Pattern {
   int maxMagnitude = 40; // max difference between two magnitude measurements
 
   // state
-  byte bufr[NUM_LEDS_CH0]; // TODO Remove hardcoding, relies on first channel being "split" mode
+  byte bufr[LOGICAL_LEDS]; // intensity per logical LED, mapped onto all states
   byte offset = 0;
   int magnitude = 10;
   int mode = HEARTBEAT_MODE_FULL;
@@ -33,25 +33,22 @@ class Heartbeat: public Pattern {
   void moveBuffer(int ledsSize) {
     int i;
     byte c = (int) beat[offset] * 255 / beatMaxIntensity;
-    int midPoint = ledsSize/2;
 
-    // Move current beat intensity from middle to beginning of strip (backward in buffer)
-    bufr[midPoint - 1] = c;
-    for (i=0;i<midPoint - 1;i++){
+    // Move current beat intensity from the end of the logical strip (the middle
+    // of the scarf) to its beginning. Mapping mirrors it onto both halves.
+    for (i=0;i<ledsSize - 1;i++){
       bufr[i] = bufr[i+1];
     }
-
-    // Move current beat intensity from middle to end of strip (forward in buffer)
-    bufr[midPoint] = c;
-    for (i=ledsSize - 1;i>midPoint;i--){
-      bufr[i] = bufr[i-1];
-    }
+    bufr[ledsSize - 1] = c;
   }
 
   void updateParameters() {
+    // Hard dancing goes past maxMagnitude, which would take the divisor below 100
+    int clamped = constrain(magnitude, minMagnitude, maxMagnitude);
+
     // Go from a cool color on low to a warm color on high activity
     hue = map(
-      magnitude,
+      clamped,
       minMagnitude,
       maxMagnitude,
       minHue,
@@ -60,7 +57,7 @@ class Heartbeat: public Pattern {
 
     // Lower magnitude means more brightness reduction
     brightnessFactor = map(
-      magnitude,
+      clamped,
       minMagnitude,
       maxMagnitude,
       maxBrightnessDivisor,
@@ -69,30 +66,33 @@ class Heartbeat: public Pattern {
   }
 
   public:
-    void loop(byte fade)
+    void loop(byte fade, byte states)
     {
       offset = (offset + 1) % beatLength;
       updateParameters();
 
       for (int i=0;i<movesPerBeat;i++){
-        // Only move *one* buffer for all states, for performance reasons
-        // TODO Remove assumption that first state has more LEDs
-        moveBuffer(_states[0]->ledsSize);
-
-        // TODO Switch to NUM_STATES
-        for(int j=0; j<NUM_STATES; j++) {
-          loopForState(_states[j], fade);
-        }
+        moveBuffer(_logicalState->ledsSize);
       }
+
+      // Render once, and map onto all states
+      loopForState(_logicalState, fade);
+      postProcess(_logicalState);
+      mapStates(states);
+    }
+
+    bool isMapped()
+    {
+      return true;
     }
 
     void loopForState(PatternState *state, byte fade)
     {
       int i;
       if (mode == HEARTBEAT_MODE_SPLIT) {
-        int halfPoint = (int)sizeof(bufr)/2;
+        int midPoint = state->ledsSize - 1; // latest intensity, see moveBuffer()
         for (i=0;i<state->ledsSize;i++){
-            state->leds[i] = CHSV(hue, bufr[halfPoint], bufr[halfPoint]/(brightnessFactor/100));
+            state->leds[i] = CHSV(hue, bufr[midPoint], bufr[midPoint]/(brightnessFactor/100));
         }
       } else if(mode == HEARTBEAT_MODE_FULL) {
         for (i=0;i<state->ledsSize;i++){
@@ -108,10 +108,18 @@ class Heartbeat: public Pattern {
       magnitude = _magnitude;
     }
 
+    /**
+     * The buffer moves in whole LEDs, blending smooths out the steps
+     */
+    bool isInterpolated()
+    {
+      return true;
+    }
+
     int getFrameLength()
     {
       // Delay in milliseconds. BPM are measured by minute, so divide accordingly.
-      long msPerBeat = (unsigned int)((60*1000) / (unsigned int)bpm);
+      int32_t msPerBeat = (unsigned int)((60*1000) / (unsigned int)bpm);
       return (int)((unsigned int)msPerBeat / (int)beatLength);
     }
 };
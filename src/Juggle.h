@@ -5,18 +5,41 @@
  */
 class Juggle: public Pattern {
   public:
+    void setup()
+    {
+      markAllActive();
+    }
+
     void loopForState(PatternState *state, byte fade)
     {
-      fadeToBlackBy( state->leds, state->ledsSize, 20);
+      state->fadeActiveToBlackFor(20, getFrameLength(), presentMillis);
       byte dothue = 0;
       for( int i = 0; i < 8; i++) {
-        state->leds[beatsin16(i+7,0,state->ledsSize)] |= CHSV(dothue, 200, 255);
+        uint16_t pos = beatsin16(i+7,0,state->ledsSize - 1); // inclusive range
+        state->leds[pos] |= CHSV(dothue, 200, 255);
+        state->markActive(pos);
         dothue += 32;
       }
     }
 
+    /**
+     * Fades and dots follow the time, so fewer frames only make the steps coarser
+     */
+    bool isGovernable()
+    {
+      return true;
+    }
+
     int getFrameLength()
     {
       return 1000 / bpm / 2;
     }
+
+    /**
+     * Soft glow around the dots
+     */
+    fract8 getBloom()
+    {
+      return 64;
+    }
 };
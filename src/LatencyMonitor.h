@@ -0,0 +1,74 @@
+#ifndef LatencyMonitor_h
+#define LatencyMonitor_h
+
+#define LATENCY_SMOOTHING 3 // average over about 2^3 frames
+
+/**
+ * Measures how long it takes from rendering a frame until it's visible,
+ * so patterns can render for the time a frame will be shown rather than
+ * the time it's rendered (e.g. to land a strobe on the kick drum).
+ *
+ * Covers rendering, the output stage and transmitting the LEDs.
+ * When present() returns before transmitting (OUTPUT_PIPELINE_THREADED),
+ * the time the frame still takes to go out is added as pendingMillis.
+ * Smoothed, so a single slow frame (e.g. a DEBUG print) doesn't shift the beat.
+ */
+class LatencyMonitor {
+  uint16_t _pendingMillis;
+  uint16_t _trimMillis;
+  uint32_t _startMillis = 0;
+  bool _started = false;
+  uint16_t _smoothed = 0; // in 1/2^LATENCY_SMOOTHING milliseconds
+
+public:
+  /**
+   * @param pendingMillis Time a frame takes to become visible after present() returns
+   * @param trimMillis Added to the measured latency, e.g. to make up for a delayed sound system
+   */
+  LatencyMonitor(uint16_t pendingMillis, uint16_t trimMillis):
+    _pendingMillis(pendingMillis), _trimMillis(trimMillis)
+  {
+    // no-op
+  }
+
+  /**
+   * Call before rendering a frame
+   * @param ms The time the frame gets rendered for
+   */
+  void start(uint32_t ms)
+  {
+    _startMillis = ms;
+    _started = true;
+  }
+
+  /**
+   * Call once the frame has been presented
+   */
+  void stop(uint32_t ms)
+  {
+    if (!_started) {
+      return;
+    }
+    _started = false;
+    uint16_t sample = min(ms - _startMillis, 1000UL) + _pendingMillis;
+    _smoothed += sample - (_smoothed >> LATENCY_SMOOTHING);
+  }
+
+  /**
+   * Measured time from rendering to a visible frame
+   */
+  uint16_t getMeasuredMillis()
+  {
+    return _smoothed >> LATENCY_SMOOTHING;
+  }
+
+  /**
+   * How far ahead to render
+   */
+  uint16_t getLookaheadMillis()
+  {
+    return getMeasuredMillis() + _trimMillis;
+  }
+};
+
+#endif
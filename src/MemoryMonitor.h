@@ -0,0 +1,191 @@
+#ifndef MemoryMonitor_h
+#define MemoryMonitor_h
+
+#define MEMORY_MONITOR_CANARY 0xC5
+#define MEMORY_MONITOR_MAGIC 0x4D45
+#define MEMORY_MONITOR_STACK_MARGIN 32 // bytes below the current stack pointer to leave unpainted
+#define MEMORY_MALLOC_OVERHEAD 2 // avr-libc keeps the size in front of each allocation
+
+/**
+ * Record the heap taken by new'ing count objects of a type as an absolute symbol
+ * (heap_<name>) in the ELF, so scripts/memory_budget.py can report it per class.
+ * Only emits assembler directives, call from any function that gets linked in.
+ */
+#ifdef __AVR__
+  #define MEMORY_REPORT_HEAP(name, type, count) \
+    asm volatile(".global heap_" #name "\n.set heap_" #name ", %0" \
+      :: "n"((sizeof(type) + MEMORY_MALLOC_OVERHEAD) * (count)))
+#else
+  #define MEMORY_REPORT_HEAP(name, type, count) ((void)0)
+#endif
+
+#ifdef __AVR__
+extern char __heap_start;
+extern char *__brkval;
+#endif
+
+struct MemoryStats {
+  uint16_t magic;
+  uint16_t minFreeBytes; // smallest gap between heap and stack seen so far
+  uint16_t maxHeapBytes;
+  uint32_t uptimeMillis;
+};
+
+/**
+ * Survives a watchdog (or reset button) reset, but not a power cycle.
+ * Kept outside the class, since .noinit needs a plain global.
+ */
+MemoryStats memoryStatsNoinit __attribute__((section(".noinit")));
+
+/**
+ * Tracks how close heap and stack get to each other.
+ *
+ * On setup, the free RAM between heap and stack gets painted with a canary value.
+ * The stack overwrites it as it grows, so scanning upwards from the top of the heap
+ * for the first overwritten byte gives the lowest free RAM ever reached,
+ * without instrumenting any calls (e.g. deep ColorFromPalette() chains).
+ * Heap usage is read from the allocator's break value.
+ *
+ * Stats are kept in .noinit RAM, so after a crash and reset,
+ * the previous run's numbers are still available.
+ */
+class MemoryMonitor {
+  MemoryStats _previous;
+  MemoryStats _current;
+  uint16_t _bootHeapBytes;
+
+  char *heapEnd()
+  {
+#ifdef __AVR__
+    return __brkval ? __brkval : &__heap_start;
+#else
+    return 0;
+#endif
+  }
+
+  uint16_t heapBytes()
+  {
+#ifdef __AVR__
+    return heapEnd() - &__heap_start;
+#else
+    return 0;
+#endif
+  }
+
+public:
+  MemoryMonitor()
+  {
+    // no-op
+  }
+
+  void setup()
+  {
+    _previous = memoryStatsNoinit;
+    if (_previous.magic != MEMORY_MONITOR_MAGIC) {
+      _previous.minFreeBytes = 0;
+      _previous.maxHeapBytes = 0;
+      _previous.uptimeMillis = 0;
+    }
+
+    // Global constructors have run by now, so this covers everything new'ed at boot
+    _bootHeapBytes = heapBytes();
+    _current.magic = MEMORY_MONITOR_MAGIC;
+    _current.maxHeapBytes = _bootHeapBytes;
+    _current.uptimeMillis = 0;
+
+#ifdef __AVR__
+    char stackMarker;
+    char *stackEnd = &stackMarker - MEMORY_MONITOR_STACK_MARGIN;
+    for (char *p = heapEnd(); p < stackEnd; p++) {
+      *p = MEMORY_MONITOR_CANARY;
+    }
+    _current.minFreeBytes = stackEnd - heapEnd();
+#else
+    _current.minFreeBytes = 0;
+#endif
+
+    memoryStatsNoinit = _current;
+  }
+
+  /**
+   * Scan for the low-water mark. Cost grows with free RAM (a few hundred bytes),
+   * so call it periodically rather than every frame.
+   */
+  void update()
+  {
+    uint16_t heap = heapBytes();
+    if (heap > _current.maxHeapBytes) {
+      _current.maxHeapBytes = heap;
+    }
+
+#ifdef __AVR__
+    char *p = heapEnd();
+    char *stackEnd = (char *)RAMEND;
+    while (p < stackEnd && *p == (char)MEMORY_MONITOR_CANARY) {
+      p++;
+    }
+    uint16_t freeBytes = p - heapEnd();
+    if (freeBytes < _current.minFreeBytes) {
+      _current.minFreeBytes = freeBytes;
+    }
+#endif
+
+    _current.uptimeMillis = millis();
+    memoryStatsNoinit = _current;
+  }
+
+  uint16_t getMinFreeBytes()
+  {
+    return _current.minFreeBytes;
+  }
+
+  /**
+   * Heap in use when setup() started, compare with scripts/memory_budget.py's estimate
+   */
+  uint16_t getBootHeapBytes()
+  {
+    return _bootHeapBytes;
+  }
+
+  uint16_t getMaxHeapBytes()
+  {
+    return _current.maxHeapBytes;
+  }
+
+  /**
+   * Stats of the run before the last reset, zero after a power cycle
+   */
+  MemoryStats getPrevious()
+  {
+    return _previous;
+  }
+
+  void printBoot()
+  {
+    Serial.print(F("memory: heap at boot "));
+    Serial.println(_bootHeapBytes);
+  }
+
+  void print()
+  {
+    Serial.print(F("memory: free min "));
+    Serial.print(_current.minFreeBytes);
+    Serial.print(F(", heap max "));
+    Serial.println(_current.maxHeapBytes);
+  }
+
+  void printPrevious()
+  {
+    if (_previous.magic != MEMORY_MONITOR_MAGIC) {
+      return;
+    }
+    Serial.print(F("memory before reset: free min "));
+    Serial.print(_previous.minFreeBytes);
+    Serial.print(F(", heap max "));
+    Serial.print(_previous.maxHeapBytes);
+    Serial.print(F(", uptime "));
+    Serial.println(_previous.uptimeMillis);
+  }
+};
+
+#endif
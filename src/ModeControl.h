@@ -1,11 +1,14 @@
-#include <Bounce2.h>
+#include "ButtonEvents.h"
 
 class ModeControl {
-  Bounce _button;
   int pin;
-  unsigned long _millisAtPress = 0;
+  uint32_t _millisAtPress = 0;
   int _longPressMillis = 500;
   bool _wasLongPress = false;
+  bool _pressed = false;
+  bool _cancelled = false; // ignore the release of the current press
+  bool _fell = false;
+  bool _rose = false;
 
 public:
   ModeControl(int _pin): pin(_pin)
@@ -13,33 +16,62 @@ public:
     // no-op
   }
 
-  void setup()
+  void setup(ButtonEvents &events)
   {
-    pinMode(pin, INPUT_PULLUP);
-    _button.attach(pin);
-    _button.interval(50);
+    events.attach(pin);
   }
 
+  /**
+   * Start a new loop, forgetting the previous loop's presses
+   */
   void update()
   {
-    _button.update();
-    if (_button.fell()) {
-      _millisAtPress = millis();
+    _fell = false;
+    _rose = false;
+  }
+
+  void handle(const ButtonEvent &event)
+  {
+    if (event.pin != pin) {
+      return;
     }
-    if (_button.rose()) {
-      _wasLongPress = ((millis() - _millisAtPress) > _longPressMillis);
+    _pressed = event.pressed;
+    if (event.pressed) {
+      _fell = true;
+      _cancelled = false;
+      _millisAtPress = event.millis;
+    } else if (_cancelled) {
+      _cancelled = false;
+    } else {
+      _rose = true;
+      _wasLongPress = ((event.millis - _millisAtPress) > _longPressMillis);
       _millisAtPress = 0;
     }
   }
 
   bool fell()
   {
-    return _button.fell();
+    return _fell;
   }
 
   bool rose()
   {
-    return _button.rose();
+    return _rose;
+  }
+
+  bool isPressed()
+  {
+    return _pressed;
+  }
+
+  /**
+   * Forget the current press, e.g. when it's part of a chord.
+   * Its release won't count as rose().
+   */
+  void cancel()
+  {
+    _fell = false;
+    _cancelled = _pressed;
   }
 
   /**
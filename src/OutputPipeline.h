@@ -0,0 +1,179 @@
+#ifndef OutputPipeline_h
+#define OutputPipeline_h
+
+#ifdef OUTPUT_PIPELINE_THREADED
+  #include <thread>
+  #include <mutex>
+  #include <condition_variable>
+#endif
+
+/**
+ * Hands rendered frames over to FastLED for transmission.
+ *
+ * By default (e.g. on the Nano) this simply calls FastLED.show(),
+ * so a frame takes render time plus transmit time.
+ *
+ * With OUTPUT_PIPELINE_THREADED defined, each channel gets a front buffer
+ * which FastLED transmits from a worker thread. Presenting a frame copies the
+ * back buffer (the one patterns draw to) into the front buffer, so the next
+ * frame can be rendered while the current one goes out.
+ * Frames are copied rather than swapped, because patterns like Sinelon
+ * fade the previous frame instead of redrawing from scratch.
+ * This needs std::thread and a second set of LED buffers, so it's only
+ * useful on bigger MCUs or host builds.
+ *
+ * With OUTPUT_GAMMA defined, the copy into the front buffer goes through
+ * OutputStage, which applies gamma, colour correction and brightness.
+ *
+ * With OUTPUT_INTERPOLATION defined, patterns which opt in through
+ * Pattern::isInterpolated() only render keyframes at their frame length,
+ * and frames are presented at OUTPUT_FRAME_LENGTH, blended between the last two keyframes.
+ *
+ * Channels with a frame rate of their own (see PatternList::assign()) are presented
+ * on their own, and only they are transmitted. The power limit then gets applied
+ * here, since it's otherwise part of FastLED.show().
+ */
+template<typename ChannelsT>
+class OutputPipeline {
+  ChannelsT &_channels;
+  uint32_t _maxMilliwatts = 0;
+
+#ifdef OUTPUT_PIPELINE_THREADED
+  std::thread _worker;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _pending = false;
+  bool _stopping = false;
+#endif
+
+  /**
+   * Brightness FastLED should apply while transmitting
+   */
+  byte transmitBrightness(byte brightness)
+  {
+#ifdef OUTPUT_GAMMA
+    return 255; // already applied by OutputStage
+#else
+    return brightness;
+#endif
+  }
+
+#ifdef OUTPUT_PIPELINE_THREADED
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for(;;) {
+      _cond.wait(lock, [this]{ return _pending || _stopping; });
+      if (!_pending) {
+        return;
+      }
+      lock.unlock();
+      FastLED.show();
+      lock.lock();
+      _pending = false;
+      _cond.notify_all();
+    }
+  }
+#endif
+
+  public:
+    OutputPipeline(ChannelsT &channels): _channels(channels)
+    {
+      // no-op
+    }
+
+    void setup()
+    {
+#ifdef OUTPUT_PIPELINE_THREADED
+      _worker = std::thread(&OutputPipeline::run, this);
+#endif
+    }
+
+#ifdef OUTPUT_PIPELINE_THREADED
+    /**
+     * Transmit the frame still pending, then stop the worker.
+     * Destroying the mutex and condition variable under a waiting thread would block forever.
+     */
+    ~OutputPipeline()
+    {
+      if (_worker.joinable()) {
+        {
+          std::lock_guard<std::mutex> lock(_mutex);
+          _stopping = true;
+        }
+        _cond.notify_all();
+        _worker.join();
+      }
+    }
+#endif
+
+    /**
+     * Wait until the frame last presented has gone out,
+     * e.g. before inspecting what FastLED transmitted
+     */
+    void flush()
+    {
+#ifdef OUTPUT_PIPELINE_THREADED
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cond.wait(lock, [this]{ return !_pending; });
+#endif
+    }
+
+    /**
+     * Limit the current drawn by all channels together, see
+     * https://github.com/FastLED/FastLED/wiki/Power-notes#managing-power-in-fastled
+     */
+    void setMaxPower(uint8_t volts, uint32_t milliamps)
+    {
+      FastLED.setMaxPowerInVoltsAndMilliamps(volts, milliamps);
+      _maxMilliwatts = volts * milliamps;
+    }
+
+    /**
+     * Time a frame still takes to become visible after present() returns,
+     * at about 30us per LED (24 bits at 800kHz)
+     */
+    static uint16_t pendingMillis()
+    {
+#ifdef OUTPUT_PIPELINE_THREADED
+      return ChannelsT::totalSize * 30UL / 1000 + 1;
+#else
+      return 0;
+#endif
+    }
+
+    /**
+     * Transmit the frame which has just been rendered.
+     * In threaded mode this only blocks while the previous frame is still going out.
+     * @param brightness Master brightness for this frame
+     * @param progress Blend from the previous keyframe (255 for the latest), see OUTPUT_INTERPOLATION
+     * @param states Bitmask of channels to present, ChannelsT::all for all of them
+     */
+    void present(byte brightness, fract8 progress, byte states)
+    {
+#ifdef OUTPUT_PIPELINE_THREADED
+      // The worker always transmits all channels, unchanged ones are simply sent again
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cond.wait(lock, [this]{ return !_pending; });
+      _channels.flip(states, brightness, progress);
+      FastLED.setBrightness(transmitBrightness(brightness));
+      _pending = true;
+      _cond.notify_all();
+#else
+      _channels.flip(states, brightness, progress);
+      if (states == ChannelsT::all) {
+        FastLED.setBrightness(transmitBrightness(brightness));
+        FastLED.show();
+      } else {
+        byte limited = transmitBrightness(brightness);
+        if (_maxMilliwatts) {
+          limited = calculate_max_brightness_for_power_mW(limited, _maxMilliwatts);
+        }
+        _channels.show(states, limited);
+      }
+#endif
+    }
+};
+
+#endif
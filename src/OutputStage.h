@@ -0,0 +1,160 @@
+#ifndef OutputStage_h
+#define OutputStage_h
+
+/**
+ * Gamma correction (2.2), generated with round(pow(i / 255.0, 2.2) * 255)
+ */
+const uint8_t gamma8[256] PROGMEM = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+// Error diffusion is a flavour of dithering
+#if defined(OUTPUT_DITHER_ERROR) && !defined(OUTPUT_DITHER)
+  #define OUTPUT_DITHER
+#endif
+
+// Dithering happens in the gamma pass, without it there's nothing to dither
+#if defined(OUTPUT_DITHER) && !defined(OUTPUT_GAMMA)
+  #error "OUTPUT_DITHER needs OUTPUT_GAMMA"
+#endif
+
+#ifdef OUTPUT_DITHER
+/**
+ * 16 bit gamma correction (2.2), generated with round(pow(i / 255.0, 2.2) * 65535)
+ */
+const uint16_t gamma16[256] PROGMEM = {
+      0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,
+     79,    94,   111,   129,   148,   169,   192,   216,   242,   270,   299,   330,
+    362,   396,   432,   469,   508,   549,   591,   635,   681,   729,   779,   830,
+    883,   938,   995,  1053,  1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+   1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,  2334,  2427,  2521,  2618,
+   2717,  2817,  2920,  3024,  3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,
+   4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,  5115,  5257,  5401,  5547,
+   5695,  5845,  5998,  6152,  6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+   7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,  9111,  9305,  9501,  9699,
+   9900, 10102, 10307, 10515, 10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254,
+  12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140, 14386, 14635, 14885, 15138,
+  15394, 15652, 15912, 16174, 16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+  18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694, 20996, 21301, 21609, 21919,
+  22231, 22546, 22863, 23182, 23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826,
+  26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627, 28988, 29351, 29717, 30086,
+  30457, 30830, 31206, 31585, 31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+  35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981, 38402, 38825, 39252, 39680,
+  40112, 40546, 40982, 41421, 41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025,
+  45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793, 49275, 49761, 50249, 50739,
+  51232, 51728, 52226, 52727, 53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+  57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097, 61642, 62190, 62741, 63295,
+  63851, 64410, 64971, 65535,
+};
+
+/**
+ * Order in which fractions light up over 8 frames (bit-reversed frame counter),
+ * so fractions average out over time rather than pulsing
+ */
+const uint8_t ditherThresholds[8] PROGMEM = {0, 128, 64, 192, 32, 160, 96, 224};
+#endif
+
+/**
+ * Final per-channel pass before transmission.
+ *
+ * Applies gamma, the channel's colour correction and master brightness
+ * in one go, through a single table lookup and one scale8 per component.
+ * Correction and brightness are folded into three scale factors per frame,
+ * rather than per LED.
+ *
+ * With OUTPUT_INTERPOLATION, the same pass also blends between
+ * the last two keyframes of a pattern.
+ *
+ * With OUTPUT_DITHER, gamma and scaling are done in 16 bit (8.8 fixed point),
+ * so dim colours keep their fractional levels rather than collapsing into a handful of steps.
+ * The fraction is turned into temporal dithering: Over a few frames, an LED alternates
+ * between the two nearest 8 bit levels. By default, an ordered threshold on the frame counter
+ * decides this, at no RAM cost beyond OUTPUT_GAMMA's front buffers. OUTPUT_DITHER_ERROR carries each LED's remaining fraction
+ * over to the next frame instead, which is more accurate but costs a byte per colour per LED.
+ * Dithering works best at a high output rate, e.g. with OUTPUT_INTERPOLATION.
+ *
+ * The result is written to a separate buffer, so patterns can keep
+ * building on their previous (uncorrected) frame.
+ */
+class OutputStage {
+#ifdef OUTPUT_DITHER
+  /**
+   * Round a 8.8 fixed point value to 8 bit, by carrying its fraction over time.
+   * Values never exceed 254.255 (65535 * 255 >> 8), so the result can't overflow.
+   */
+  static inline uint8_t dither(uint16_t value, uint8_t threshold, byte *error)
+  {
+#ifdef OUTPUT_DITHER_ERROR
+    uint16_t sum = (value & 0xFF) + *error;
+    *error = sum & 0xFF;
+    uint8_t carry = sum >> 8;
+#else
+    uint8_t carry = (value & 0xFF) > threshold;
+#endif
+    return (value >> 8) + carry;
+  }
+#endif
+
+  public:
+    /**
+     * @param from Previous keyframe
+     * @param to Latest keyframe
+     * @param progress How far to blend from the previous to the latest keyframe, 255 shows the latest as-is
+     * @param frame Counter for dithering, increase once per call
+     * @param error Dithering fractions, three bytes per LED (only with OUTPUT_DITHER_ERROR)
+     */
+    static void apply(const CRGB *from, const CRGB *to, fract8 progress, CRGB *dst, uint16_t size, uint32_t correction, byte brightness, byte frame, byte *error)
+    {
+      uint8_t scaleR = scale8_video((correction >> 16) & 0xFF, brightness);
+      uint8_t scaleG = scale8_video((correction >> 8) & 0xFF, brightness);
+      uint8_t scaleB = scale8_video(correction & 0xFF, brightness);
+
+      for(uint16_t i = 0; i < size; i++) {
+        CRGB pixel = (progress == 255) ? to[i] : blend(from[i], to[i], progress);
+#ifdef OUTPUT_DITHER
+        uint8_t threshold = pgm_read_byte(&ditherThresholds[(frame + i) & 7]);
+        dst[i].r = dither(((uint32_t)pgm_read_word(&gamma16[pixel.r]) * scaleR) >> 8, threshold, error + i * 3);
+        dst[i].g = dither(((uint32_t)pgm_read_word(&gamma16[pixel.g]) * scaleG) >> 8, threshold, error + i * 3 + 1);
+        dst[i].b = dither(((uint32_t)pgm_read_word(&gamma16[pixel.b]) * scaleB) >> 8, threshold, error + i * 3 + 2);
+#else
+        // scale8_video keeps dim pixels lit instead of rounding them to black
+        dst[i].r = scale8_video(pgm_read_byte(&gamma8[pixel.r]), scaleR);
+        dst[i].g = scale8_video(pgm_read_byte(&gamma8[pixel.g]), scaleG);
+        dst[i].b = scale8_video(pgm_read_byte(&gamma8[pixel.b]), scaleB);
+#endif
+      }
+    }
+
+    /**
+     * Blend between keyframes without any other correction,
+     * used when FastLED applies correction and brightness itself.
+     */
+    static void interpolate(const CRGB *from, const CRGB *to, fract8 progress, CRGB *dst, uint16_t size)
+    {
+      if (progress == 255) {
+        memcpy(dst, to, size * sizeof(CRGB));
+        return;
+      }
+
+      for(uint16_t i = 0; i < size; i++) {
+        dst[i] = blend(from[i], to[i], progress);
+      }
+    }
+};
+
+#endif
@@ -19,6 +19,22 @@ class PaletteList {
       return _palettes[_curr];
     }
 
+    /**
+     * Skip ahead by a number of palettes
+     */
+    CRGBPalette16* advance(byte steps) {
+      _curr = (_curr + steps) % _num;
+      return _palettes[_curr];
+    }
+
+    /**
+     * Switch to a specific palette
+     */
+    CRGBPalette16* select(byte index) {
+      _curr = index % _num;
+      return _palettes[_curr];
+    }
+
     CRGBPalette16* curr()
     {
       return _palettes[_curr];
@@ -30,4 +46,14 @@ class PaletteList {
     void rand() {
       _curr = random(_num);
     }
+
+    byte getIndex()
+    {
+      return _curr;
+    }
+
+    byte getCount()
+    {
+      return _num;
+    }
 };
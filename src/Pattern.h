@@ -2,6 +2,9 @@
 #define Pattern_h
 
 #include "PatternState.h"
+#include "PostProcess.h"
+
+#define ALL_STATES 0xFF
 
 /**
  * Abstract base class for all patterns
@@ -12,11 +15,30 @@ class Pattern {
 
   protected:
     PatternState *_states[NUM_STATES];
+    PatternState *_logicalState = 0;
     int bpm = 120;
-    bool onBeat = false;
+    bool onBeat = false; // a beat started since the last rendered frame, see setOnBeat()
     float beatProgress = 0;
     bool isDropping = false;
 
+    /**
+     * When the frame being rendered will be visible, see LatencyMonitor.
+     * Use this rather than millis() for anything moving in time.
+     */
+    uint32_t presentMillis = 0;
+
+    /**
+     * Flag all LEDs of all states as lit. Call from setup() in patterns using
+     * PatternState::fadeActiveToBlackBy(), since the previous pattern
+     * might have left LEDs lit without tracking them.
+     */
+    void markAllActive()
+    {
+      for(int i = 0 ; i < NUM_STATES ; i++) {
+        _states[i]->markAllActive();
+      }
+    }
+
   public:
     /**
      * Prepare the pattern to start running.
@@ -43,26 +65,133 @@ class Pattern {
       _states[index] = state;
     };
 
-    virtual void loop(byte fade)
+    /**
+     * Link the logical strip, which mapped patterns render to
+     */
+    void setLogicalState(PatternState *state)
+    {
+      _logicalState = state;
+    }
+
+    /**
+     * @param states Bitmask of the states to render (e.g. channels with a frame due), ALL_STATES for all
+     */
+    virtual void loop(byte fade, byte states)
+    {
+      if (isMapped()) {
+        loopForState(_logicalState, fade);
+        postProcess(_logicalState);
+        mapStates(states);
+        return;
+      }
+
+      for(int i = 0 ; i < NUM_STATES ; i++) {
+        if (states & (1 << i)) {
+          loopForState(_states[i], fade);
+          postProcess(_states[i]);
+        }
+      }
+    }
+
+    /**
+     * Apply the effects the pattern asks for to a rendered state, see PostProcess
+     */
+    void postProcess(PatternState *state)
+    {
+      PostProcess::apply(state, getBlur(), getBloom(), getTrail());
+    }
+
+    /**
+     * Opt into softening the rendered frame, see PostProcess
+     */
+    virtual fract8 getBlur()
+    {
+      return 0;
+    }
+
+    /**
+     * Opt into a glow around lit LEDs, see PostProcess
+     */
+    virtual fract8 getBloom()
+    {
+      return 0;
+    }
+
+    /**
+     * Opt into a tail behind lit LEDs, see PostProcess
+     */
+    virtual fract8 getTrail()
+    {
+      return 0;
+    }
+
+    /**
+     * Copy the logical strip onto states
+     * @param states Bitmask, see loop()
+     */
+    void mapStates(byte states)
     {
       for(int i = 0 ; i < NUM_STATES ; i++) {
-        loopForState(_states[i], fade);
+        if (states & (1 << i)) {
+          _states[i]->mapFrom(_logicalState);
+        }
       }
     }
 
+    /**
+     * Opt into rendering once to the logical strip, rather than once per state.
+     * The result is mapped onto each state through PatternState::setMapping().
+     */
+    virtual bool isMapped()
+    {
+      return false;
+    }
+
     virtual int getFrameLength()
     {
       return FRAME_LENGTH;
     }
 
+    /**
+     * Opt into rendering keyframes only, with the output blending between them.
+     * Suits patterns with smooth, continuous motion, see OUTPUT_INTERPOLATION.
+     */
+    virtual bool isInterpolated()
+    {
+      return false;
+    }
+
+    /**
+     * Opt into FRAME_GOVERNOR slowing the frame rate while the pattern is near-static.
+     * Only suits patterns that move with time rather than per frame,
+     * fading with PatternState::fadeActiveToBlackFor() rather than by a fixed amount per frame,
+     * since fades and trails would otherwise slow down along with the frame rate.
+     */
+    virtual bool isGovernable()
+    {
+      return false;
+    }
+
     void setBpm(int _bpm)
     {
       bpm = _bpm;
     }
 
+    /**
+     * Most updates don't render a frame, so a beat is kept until one has been rendered
+     * @param _onBeat True for the update a beat starts on, see BeatControl::onBeat()
+     */
     void setOnBeat(bool _onBeat)
     {
-      onBeat = _onBeat;
+      onBeat = onBeat || _onBeat;
+    }
+
+    /**
+     * Called once a frame has been rendered, see setOnBeat()
+     */
+    void frameRendered()
+    {
+      onBeat = false;
     }
 
     void setBeatProgress(float _beatProgress)
@@ -75,6 +204,11 @@ class Pattern {
       isDropping = _isDropping;
     }
 
+    void setPresentMillis(uint32_t _presentMillis)
+    {
+      presentMillis = _presentMillis;
+    }
+
 };
 
 #endif
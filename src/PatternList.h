@@ -1,6 +1,16 @@
 #include "Pattern.h"
 #include <FastLED.h>
 
+#define CHANNEL_FOLLOW -1
+
+/**
+ * What a channel runs, see PatternList::assign()
+ */
+struct ChannelPlan {
+  int8_t pattern; // index into the list, or CHANNEL_FOLLOW for the current pattern
+  uint16_t frameLength; // in milliseconds, 0 for the pattern's own
+};
+
 /**
  * Represents a list of patterns that you can switch between
  *
@@ -11,17 +21,120 @@ class PatternList {
     byte _curPattern;
     byte _numPatterns;
     Pattern **_patterns;
+    int8_t _assigned[NUM_STATES]; // see assign()
 
   public:
     PatternList(byte numPatterns, Pattern **patterns): _curPattern(0), _numPatterns(numPatterns), _patterns(patterns) {
+      for(byte i = 0; i < NUM_STATES; i++) {
+        _assigned[i] = CHANNEL_FOLLOW;
+      }
     }
 
     void setup() {
       _patterns[_curPattern]->setup();
     }
 
-    void loop(byte fade) {
-      _patterns[_curPattern]->loop(fade);
+    /**
+     * Render states with the pattern each of them runs.
+     * States following the current pattern are rendered in one go,
+     * so mapped patterns still only render their logical strip once.
+     * @param states Bitmask, see Pattern::loop()
+     */
+    void loop(byte fade, byte states) {
+      loopAssigned(fade, states);
+      byte following = followingStates();
+      if (states & following) {
+        _patterns[_curPattern]->loop(fade, states & following);
+        _patterns[_curPattern]->frameRendered();
+      }
+    }
+
+    /**
+     * Render states on a frame rate of their own (see ChannelPlan), between loop() calls.
+     * A mapped current pattern keeps its history (e.g. Fire's heat) on the logical strip,
+     * so states following it are mapped again from its last frame rather than rendered twice.
+     * @param states Bitmask, see Pattern::loop()
+     */
+    void loopOwnRate(byte fade, byte states) {
+      loopAssigned(fade, states);
+      byte following = states & followingStates();
+      if (!following) {
+        return;
+      }
+      Pattern *pattern = _patterns[_curPattern];
+      if (pattern->isMapped()) {
+        pattern->mapStates(following);
+      } else {
+        // Leave beats for the next loop(), which renders the current pattern's own frames
+        pattern->loop(fade, following);
+      }
+    }
+
+    /**
+     * Bitmask of states following the current pattern, see assign()
+     */
+    byte followingStates()
+    {
+      byte following = 0;
+      for(byte i = 0; i < NUM_STATES; i++) {
+        if (_assigned[i] == CHANNEL_FOLLOW) {
+          following |= 1 << i;
+        }
+      }
+      return following;
+    }
+
+    /**
+     * Render the states with a pattern assigned to them
+     */
+    void loopAssigned(byte fade, byte states)
+    {
+      for(byte i = 0; i < NUM_STATES; i++) {
+        if (_assigned[i] != CHANNEL_FOLLOW && (states & (1 << i))) {
+          _patterns[_assigned[i]]->loop(fade, 1 << i);
+          _patterns[_assigned[i]]->frameRendered();
+        }
+      }
+    }
+
+    /**
+     * Run a fixed pattern on a state, rather than the current one (e.g. a cheap one on a small channel).
+     * A pattern's own state (e.g. its hue) advances with every render, so running the same pattern
+     * on a channel at a different rate than the current one makes it move faster.
+     * Mapped patterns can't be assigned: they keep their history (e.g. Fire's heat) on the
+     * logical strip, which the current pattern renders to as well.
+     * @param index Pattern index, or CHANNEL_FOLLOW to follow the current pattern again
+     * @return False if the pattern is mapped, the state follows the current pattern instead
+     */
+    bool assign(byte state, int8_t index)
+    {
+      bool assigned = true;
+      if (index != CHANNEL_FOLLOW) {
+        index %= _numPatterns;
+        assigned = !_patterns[index]->isMapped();
+      }
+      _assigned[state] = assigned ? index : CHANNEL_FOLLOW;
+      forState(state)->setup();
+      return assigned;
+    }
+
+    /**
+     * True if a state runs the current pattern, see assign()
+     */
+    bool isFollowing(byte state)
+    {
+      return _assigned[state] == CHANNEL_FOLLOW;
+    }
+
+    /**
+     * The pattern a state runs, see assign()
+     */
+    Pattern* forState(byte state)
+    {
+      if (_assigned[state] == CHANNEL_FOLLOW) {
+        return _patterns[_curPattern];
+      }
+      return _patterns[_assigned[state]];
     }
 
     void setState(int index, PatternState *state)
@@ -31,6 +144,13 @@ class PatternList {
       }
     }
 
+    void setLogicalState(PatternState *state)
+    {
+      for(byte i = 0; i < _numPatterns; i++) {
+        _patterns[i]->setLogicalState(state);
+      }
+    }
+
     /**
      * Switch to the next ponattern
      */
@@ -45,6 +165,33 @@ class PatternList {
       return _patterns[_curPattern];
     }
 
+    /**
+     * Set up a pattern ahead of switching to it, see BeatScheduler
+     * @param steps How far ahead of the current pattern
+     */
+    void prepare(byte steps)
+    {
+      _patterns[(_curPattern + steps) % _numPatterns]->setup();
+    }
+
+    /**
+     * Switch to a pattern which has been set up through prepare()
+     */
+    Pattern* advance(byte steps)
+    {
+      _curPattern = (_curPattern + steps) % _numPatterns;
+      return _patterns[_curPattern];
+    }
+
+    /**
+     * Switch to a specific pattern
+     */
+    Pattern* select(byte index) {
+      _curPattern = index % _numPatterns;
+      setup();
+      return _patterns[_curPattern];
+    }
+
     /**
      * Switch to a random pattern
      */
@@ -52,4 +199,14 @@ class PatternList {
       _curPattern = random(_numPatterns);
       setup();
     }
+
+    byte getIndex()
+    {
+      return _curPattern;
+    }
+
+    byte getCount()
+    {
+      return _numPatterns;
+    }
 };
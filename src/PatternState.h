@@ -1,6 +1,19 @@
 #ifndef PatternState_h
 #define PatternState_h
 
+#define PATTERN_STATE_MAX_FADE_MILLIS 250 // longest time fadeActiveToBlackFor() catches up on at once
+
+/**
+ * A run of physical LEDs, mapped from a position on the logical strip.
+ * Positions are in 1/256th of a logical LED, so segments can be mirrored
+ * (negative step) or stretched to cover more or less of the logical strip.
+ */
+struct MapSegment {
+  uint16_t count; // physical LEDs in this segment
+  uint16_t start; // logical LED of the segment's first physical LED
+  int16_t step; // logical distance between physical LEDs, 256 for one LED
+};
+
 /**
  * Provides shared state between patterns.
  * State for a pattern can be memory intensive and with only 2KB of SRAM availble,
@@ -18,40 +31,184 @@ class PatternState {
      */
     byte *activation;
 
+    /**
+     * One bit per LED, set while the LED might be lit.
+     * Lets fading patterns skip the (mostly black) rest of the strip.
+     */
+    byte *active;
+
+    /**
+     * Segments in PROGMEM, see mapFrom()
+     */
+    const MapSegment *mapping;
+    byte mappingSize;
+
+    /**
+     * Time faded up to, see fadeActiveToBlackFor()
+     */
+    uint32_t fadedMillis;
+
   public:
     /**
      * The LEDs to write to
      */
     CRGB *leds;
 
-    byte ledsSize;
+    uint16_t ledsSize;
 
     /**
      * A palette to for the patterns to use.
      */
     CRGBPalette16 *palette;
 
-    PatternState(byte _ledsSize, CRGB *_leds): activation(0)
+    /**
+     * @param _active Bitmap with at least (_ledsSize + 7) / 8 bytes
+     * @param _activation Optional, _ledsSize bytes, see getActivation()
+     */
+    PatternState(uint16_t _ledsSize, CRGB *_leds, byte *_active, byte *_activation = 0): activation(_activation), active(_active), mapping(0), mappingSize(0), fadedMillis(0)
     {
       ledsSize = _ledsSize;
 
       leds = _leds;
-      for(byte i = 0; i < ledsSize; i++) {
+      for(uint16_t i = 0; i < ledsSize; i++) {
         leds[i] = CRGB::Black;
       }
+      for(uint16_t i = 0; i < activeSize(); i++) {
+        active[i] = 0;
+      }
     };
 
-    byte *getActivation()
+    /**
+     * Describe where this state's LEDs are physically,
+     * relative to the logical strip that mapped patterns render to.
+     * @param _mapping Segments in PROGMEM, covering the LEDs from the start
+     */
+    void setMapping(const MapSegment *_mapping, byte _mappingSize)
     {
-      // Allocate the byte array if it hasn't realy been allocated
-      if ((unsigned int)activation == 0) {
-        Serial.println("Allocating activation");
-        activation = new byte[ledsSize];
-        for(byte i = 0; i < ledsSize; i++) {
-          activation[i] = 0;
+      mapping = _mapping;
+      mappingSize = _mappingSize;
+    }
+
+    /**
+     * Copy a frame rendered to the logical strip onto this state's LEDs.
+     * Without a mapping, LEDs are copied one to one.
+     */
+    void mapFrom(PatternState *logical)
+    {
+      if (!mappingSize) {
+        memcpy(leds, logical->leds, min(ledsSize, logical->ledsSize) * sizeof(CRGB));
+        return;
+      }
+
+      uint16_t index = 0;
+      for(byte s = 0; s < mappingSize; s++) {
+        MapSegment segment;
+        memcpy_P(&segment, &mapping[s], sizeof(MapSegment));
+
+        int32_t position = (int32_t)segment.start << 8;
+        for(uint16_t i = 0; i < segment.count && index < ledsSize; i++) {
+          uint16_t logicalIndex = position >> 8;
+          if (logicalIndex < logical->ledsSize) {
+            leds[index] = logical->leds[logicalIndex];
+          }
+          index++;
+          position += segment.step;
         }
       }
+    }
 
+    uint16_t activeSize()
+    {
+      return (ledsSize + 7) / 8;
+    }
+
+    /**
+     * Flag an LED as lit, call after writing to it
+     * when the pattern uses fadeActiveToBlackBy()
+     */
+    void markActive(uint16_t index)
+    {
+      active[index >> 3] |= (1 << (index & 7));
+    }
+
+    /**
+     * Flag all LEDs as possibly lit, e.g. when taking over
+     * from a pattern which doesn't track them
+     */
+    void markAllActive()
+    {
+      for(uint16_t i = 0; i < activeSize(); i++) {
+        active[i] = 0xFF;
+      }
+    }
+
+    /**
+     * Same as fadeToBlackBy(leds, ledsSize, fadeBy), but only visits lit LEDs.
+     * LEDs are retired from the active set once they're black.
+     */
+    void fadeActiveToBlackBy(uint8_t fadeBy)
+    {
+      for(uint16_t i = 0; i < activeSize(); i++) {
+        byte bits = active[i];
+        if (!bits) {
+          continue;
+        }
+
+        for(byte bit = 0; bit < 8; bit++) {
+          byte mask = 1 << bit;
+          if (!(bits & mask)) {
+            continue;
+          }
+
+          uint16_t index = (i << 3) + bit;
+          if (index >= ledsSize) {
+            bits &= ~mask;
+            continue;
+          }
+
+          leds[index].fadeToBlackBy(fadeBy);
+          if (!leds[index]) {
+            bits &= ~mask;
+          }
+        }
+        active[i] = bits;
+      }
+    }
+
+    /**
+     * fadeActiveToBlackBy() for the time since the last call rather than per frame,
+     * so trails look the same at any frame rate (e.g. under FRAME_GOVERNOR).
+     * Fading compounds, so fadeBy is applied once per whole frameLength and in proportion for the rest.
+     * @param fadeBy Amount to fade by per frameLength
+     * @param frameLength In milliseconds, usually the pattern's getFrameLength()
+     * @param ms Time of the frame, see Pattern::presentMillis
+     * @return Milliseconds faded for, at most PATTERN_STATE_MAX_FADE_MILLIS
+     */
+    uint16_t fadeActiveToBlackFor(uint8_t fadeBy, uint16_t frameLength, uint32_t ms)
+    {
+      int32_t elapsed = ms - fadedMillis;
+      fadedMillis = ms;
+      if (elapsed <= 0 || !frameLength) {
+        return 0;
+      }
+      // Stale after switching patterns, fade out what the last one left without wiping it
+      elapsed = min(elapsed, (int32_t)PATTERN_STATE_MAX_FADE_MILLIS);
+
+      uint16_t keep = 256; // share of each LED to keep, in 1/256
+      uint16_t rest = elapsed;
+      for(; rest >= frameLength; rest -= frameLength) {
+        keep = (uint32_t)keep * (256 - fadeBy) >> 8;
+      }
+      keep -= (uint32_t)keep * fadeBy * rest / frameLength >> 8;
+      fadeActiveToBlackBy(keep ? 256 - keep : 255);
+      return elapsed;
+    }
+
+    /**
+     * @return The activation buffer, 0 for states constructed without one
+     */
+    byte *getActivation()
+    {
       return activation;
     };
 
@@ -8,9 +8,26 @@ class Plasma: public Pattern {
     void loopForState(PatternState *state, byte fade)
     {
       for (int i = 0; i < state->ledsSize; i++) {
-        byte c = sin8((long) i * 30 - millis() / 2);
+        byte c = sin8((int32_t) i * 30 - presentMillis / 2);
         byte colorindex = scale8(c, 200);
         state->leds[i] = ColorFromPalette(*state->palette, colorindex);
       }
     }
+
+    /**
+     * The wave moves continuously, so blending keyframes looks the same
+     * as rendering every frame, for a fraction of the ColorFromPalette() calls
+     */
+    bool isInterpolated()
+    {
+      return true;
+    }
+
+    /**
+     * Drawn from the time alone
+     */
+    bool isGovernable()
+    {
+      return true;
+    }
 };
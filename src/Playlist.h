@@ -0,0 +1,18 @@
+// Generated by scripts/compile_playlist.py from playlist.txt, don't edit by hand.
+// See Sequencer.h for the step encoding.
+
+#define PLAYLIST_STEPS 11
+
+const byte playlist[PLAYLIST_STEPS * 2] PROGMEM = {
+  0x00,   8, // bpm         ocean    -     8
+  0x1C,   8, // heartbeat   keep     -     8
+  0x22,   8, // plasma      lava     -     8
+  0x0D,   2, // bpm         keep     drop  2
+  0x34,   8, // juggle      rainbow  -     8
+  0x4E,   4, // sinelon     random   -     4
+  0x4D,   1, // sinelon     keep     drop  1
+  0x5C,   8, // confetti    keep     -     8
+  0x72,   8, // fire        lava     -     8
+  0xFE,   8, // random      random   -     8
+  0x0D,   4, // bpm         keep     drop  4
+};
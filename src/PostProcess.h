@@ -0,0 +1,68 @@
+#ifndef PostProcess_h
+#define PostProcess_h
+
+#include "PatternState.h"
+
+/**
+ * Glow effects applied to a pattern's frame after rendering, see Pattern::getBlur() etc.
+ *
+ * Runs in place in a single pass, carrying the previous pixel (as rendered and as output)
+ * instead of needing a temporary frame, which wouldn't fit into the Nano's SRAM.
+ *  - Blur: Spreads part of each pixel to its neighbours, softening hard edges.
+ *    Keeps the overall brightness, but spreads further every frame it's applied to
+ *    the same LEDs, so it only suits patterns which redraw every frame.
+ *  - Bloom: Lights up neighbours to a fraction of each pixel (taking the brighter of both),
+ *    so single dots glow. Since it never adds up, patterns fading their previous frame
+ *    (e.g. Juggle) settle into a glow falling off by the bloom factor per LED.
+ *  - Trail: A tail behind each pixel towards the end of the strip,
+ *    falling off by the trail factor per LED.
+ * Pixels lit this way are marked as active, see PatternState::fadeActiveToBlackBy().
+ */
+class PostProcess {
+  public:
+    /**
+     * @param blur Share of a pixel spread to its neighbours, 0 for none
+     * @param bloom Brightness of neighbours relative to a pixel, 0 for none
+     * @param trail Brightness of each trail pixel relative to the one before, 0 for none
+     */
+    static void apply(PatternState *state, fract8 blur, fract8 bloom, fract8 trail)
+    {
+      if (!blur && !bloom && !trail) {
+        return;
+      }
+
+      CRGB *leds = state->leds;
+      fract8 keep = 255 - blur;
+      fract8 spread = blur >> 1;
+      CRGB prev = CRGB::Black; // previous pixel as rendered
+      CRGB tail = CRGB::Black; // previous pixel as output
+
+      for (uint16_t i = 0; i < state->ledsSize; i++) {
+        CRGB cur = leds[i];
+        CRGB next = (i + 1 < state->ledsSize) ? leds[i + 1] : CRGB(CRGB::Black);
+        CRGB out = cur;
+
+        if (blur) {
+          out.nscale8(keep);
+          out += CRGB(prev).nscale8(spread);
+          out += CRGB(next).nscale8(spread);
+        }
+        if (bloom) {
+          out |= CRGB(prev).nscale8(bloom);
+          out |= CRGB(next).nscale8(bloom);
+        }
+        if (trail) {
+          out |= tail.nscale8(trail);
+        }
+
+        if (out != cur) {
+          leds[i] = out;
+          state->markActive(i);
+        }
+        tail = out;
+        prev = cur;
+      }
+    }
+};
+
+#endif
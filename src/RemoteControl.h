@@ -0,0 +1,137 @@
+#ifndef RemoteControl_h
+#define RemoteControl_h
+
+#define REMOTE_START_1 0xA9
+#define REMOTE_START_2 0x9A
+#define REMOTE_MAX_PAYLOAD 16
+#define REMOTE_REPLY 0x80 // set on the command of replies
+#define REMOTE_TIMEOUT_MILLIS 250 // drops a frame cut off this long ago, longer than any loop takes
+
+// Commands, payload in brackets (multi-byte values little endian)
+#define REMOTE_SET_PATTERN 0x01 // [index], on the next beat like the mode button
+#define REMOTE_SET_PALETTE 0x02 // [index], on the next beat like a long press of the mode button
+#define REMOTE_SET_BEAT 0x03 // [beatLength(2) barPhase(2)], barPhase 0xFFFF keeps the phase
+#define REMOTE_DROP 0x04 // [1 to start, 0 to stop], snapped to the beat like the drop button
+#define REMOTE_SET_BRIGHTNESS 0x05 // [level], see BrightnessControl
+#define REMOTE_QUERY_STATS 0x06 // [], replies with pattern palette brightness flags beatLength(2) minFreeBytes(2) latency(2) lostMillis(4)
+#define REMOTE_PING 0x07 // [any], replies with the same payload, e.g. to check the link
+#define REMOTE_VM_BEGIN 0x08 // [mode length], starts a VmPattern upload, replies [status], see VmUploader
+#define REMOTE_VM_DATA 0x09 // [offset code...], up to VM_CHUNK_SIZE code bytes, replies [status]
+#define REMOTE_VM_COMMIT 0x0A // [checksum], replies [status]
+
+/**
+ * Receives commands from a laptop or another controller over serial,
+ * see scripts/remote.py.
+ *
+ * Frame: A9 9A command length payload[length] checksum,
+ * where the checksum is the XOR of command, length and payload.
+ * Replies use the same framing, with REMOTE_REPLY set on the command.
+ * Bytes are fed in as they arrive, without blocking the frame loop,
+ * and payloads are limited to REMOTE_MAX_PAYLOAD, so RAM use is fixed.
+ * A frame cut off (e.g. by a loose connector) would swallow the start of the next one,
+ * so one stalled for REMOTE_TIMEOUT_MILLIS is dropped.
+ * main.cpp hands commands to the same controls and scheduler the buttons use.
+ */
+class RemoteControl {
+  byte _state = 0; // position in the frame
+  byte _command;
+  byte _length;
+  byte _received;
+  byte _checksum;
+  byte _payload[REMOTE_MAX_PAYLOAD];
+  uint32_t _lastMillis = 0; // when the last byte arrived
+
+public:
+  /**
+   * Feed a received byte
+   * @param ms Current time, see Clock
+   * @return True when a complete command has been received
+   */
+  bool receive(byte b, uint32_t ms)
+  {
+    if (ms - _lastMillis > REMOTE_TIMEOUT_MILLIS) {
+      _state = 0;
+    }
+    _lastMillis = ms;
+
+    switch (_state) {
+      case 0:
+        _state = (b == REMOTE_START_1) ? 1 : 0;
+        break;
+      case 1:
+        _state = (b == REMOTE_START_2) ? 2 : (b == REMOTE_START_1 ? 1 : 0);
+        break;
+      case 2:
+        _command = b;
+        _checksum = b;
+        _state = 3;
+        break;
+      case 3:
+        if (b > REMOTE_MAX_PAYLOAD) {
+          _state = 0;
+          break;
+        }
+        _length = b;
+        _checksum ^= b;
+        _received = 0;
+        _state = _length ? 4 : 5;
+        break;
+      case 4:
+        _payload[_received++] = b;
+        _checksum ^= b;
+        if (_received == _length) {
+          _state = 5;
+        }
+        break;
+      case 5:
+        _state = 0;
+        return b == _checksum;
+    }
+    return false;
+  }
+
+  byte getCommand()
+  {
+    return _command;
+  }
+
+  byte getLength()
+  {
+    return _length;
+  }
+
+  byte *getPayload()
+  {
+    return _payload;
+  }
+
+  uint16_t readWord(byte offset)
+  {
+    return _payload[offset] | (_payload[offset + 1] << 8);
+  }
+
+  /**
+   * Answer the last command
+   */
+  void reply(Stream &stream, const byte *payload, byte length)
+  {
+    byte header[4] = {REMOTE_START_1, REMOTE_START_2, (byte)(_command | REMOTE_REPLY), length};
+    byte checksum = header[2] ^ length;
+    for (byte i = 0; i < length; i++) {
+      checksum ^= payload[i];
+    }
+    stream.write(header, 4);
+    stream.write(payload, length);
+    stream.write(checksum);
+  }
+
+  /**
+   * Answer the last command with a single byte, e.g. a status
+   */
+  void reply(Stream &stream, byte value)
+  {
+    reply(stream, &value, 1);
+  }
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef Sequencer_h
+#define Sequencer_h
+
+#include "FastRandom.h"
+
+// Playlist step encoding, two bytes per step:
+// - First byte: pattern (bits 4-7), palette (bits 1-3), drop (bit 0)
+// - Second byte: duration in bars
+// Generate playlists with scripts/compile_playlist.py rather than by hand.
+#define PLAYLIST_PATTERN_KEEP 0xE
+#define PLAYLIST_PATTERN_RANDOM 0xF
+#define PLAYLIST_PALETTE_KEEP 0x6
+#define PLAYLIST_PALETTE_RANDOM 0x7
+
+/**
+ * Autopilot, playing a playlist of patterns, palettes and drops
+ * in time with the bars tapped out through BeatControl.
+ *
+ * The playlist lives in flash, only the position in it takes up RAM.
+ * Steps change on the first beat of a bar, and loop back to the start.
+ * Each step's pattern and palette are handed out a bar ahead, to be queued in the
+ * BeatScheduler like button presses, so the pattern is set up before the downbeat.
+ */
+class Sequencer {
+  const byte *_playlist;
+  byte _numSteps;
+  byte _step = 0;
+  byte _next = 0;
+  byte _barsLeft = 0; // including the current one
+  bool _enabled = false;
+  bool _queued = false; // the next step has been handed out, and starts on the next bar
+  bool _dropping = false;
+
+  byte readByte(byte step, byte offset)
+  {
+    return pgm_read_byte(&_playlist[step * 2 + offset]);
+  }
+
+public:
+  /**
+   * @param playlist Steps in PROGMEM
+   * @param numSteps Number of (two byte) steps
+   */
+  Sequencer(const byte *playlist, byte numSteps): _playlist(playlist), _numSteps(numSteps)
+  {
+    // no-op
+  }
+
+  bool isEnabled()
+  {
+    return _enabled;
+  }
+
+  /**
+   * Turn autopilot on or off, restarting the playlist when turned on
+   */
+  void toggle()
+  {
+    _enabled = !_enabled;
+    _step = 0;
+    _next = 0;
+    _barsLeft = 0;
+    _queued = false;
+    _dropping = false;
+  }
+
+  /**
+   * Call once per loop
+   * @param onBar Whether a new bar has started since the last call
+   * @return True when the next step should be queued for the next bar, see getPattern() and getPalette()
+   */
+  bool update(bool onBar)
+  {
+    if (!_enabled || !_numSteps) {
+      return false;
+    }
+
+    if (onBar) {
+      if (_queued) {
+        _step = _next;
+        _next = (_step + 1) % _numSteps;
+        _barsLeft = readByte(_step, 1);
+        _dropping = readByte(_step, 0) & 1;
+        _queued = false;
+      } else if (_barsLeft) {
+        _barsLeft--;
+      }
+    }
+
+    // Nothing left before the very first step either
+    if (!_queued && _barsLeft <= 1) {
+      _queued = true;
+      return true;
+    }
+    return false;
+  }
+
+  /**
+   * Pattern of the next step
+   * @param count Number of patterns, to pick a random one from
+   * @return Index, or -1 to keep the current pattern
+   */
+  int8_t getPattern(byte count)
+  {
+    byte pattern = readByte(_next, 0) >> 4;
+    if (pattern == PLAYLIST_PATTERN_RANDOM) {
+      return fastRandom.below(count);
+    }
+    return pattern == PLAYLIST_PATTERN_KEEP ? -1 : pattern;
+  }
+
+  /**
+   * Palette of the next step
+   * @param count Number of palettes, to pick a random one from
+   * @return Index, or -1 to keep the current palette
+   */
+  int8_t getPalette(byte count)
+  {
+    byte palette = (readByte(_next, 0) >> 1) & 0x7;
+    if (palette == PLAYLIST_PALETTE_RANDOM) {
+      return fastRandom.below(count);
+    }
+    return palette == PLAYLIST_PALETTE_KEEP ? -1 : palette;
+  }
+
+  bool isDropping()
+  {
+    return _enabled && _dropping;
+  }
+};
+
+#endif
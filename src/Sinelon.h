@@ -11,23 +11,45 @@ class Sinelon: public Pattern {
   uint8_t gHue = 0;
 
   public:
+    void setup()
+    {
+      markAllActive();
+    }
+
     void loopForState(PatternState *state, byte fade)
     {
-      fadeToBlackBy( state->leds, state->ledsSize, 20);
-      int pos = beatsin16(bpm/8, 0, state->ledsSize);
+      state->fadeActiveToBlackFor(20, getFrameLength(), presentMillis);
+      int pos = beatsin16(bpm/8, 0, state->ledsSize - 1); // inclusive range
       if (isDropping) {
           state->leds[pos] += CHSV( gHue, 0, 255); // white
       } else {
         state->leds[pos] += CHSV( gHue, 255, 192);
       }
+      state->markActive(pos);
 
 
       EVERY_N_MILLISECONDS( 20 ) { gHue++; }
     }
 
+    /**
+     * Fades and dots follow the time, so fewer frames only make the steps coarser
+     */
+    bool isGovernable()
+    {
+      return true;
+    }
+
     virtual int getFrameLength()
     {
       return 1000 / 60; // run a bit faster to give beatsin16 enough samples
     }
 
+    /**
+     * Soft glow around the dot
+     */
+    fract8 getBloom()
+    {
+      return 64;
+    }
+
 };
@@ -0,0 +1,228 @@
+#ifndef VmPattern_h
+#define VmPattern_h
+
+#include <EEPROM.h>
+#include "Pattern.h"
+#include "FastRandom.h"
+
+// Program layout in EEPROM: magic, mode, code length, code.
+// There are two slots, uploads go to the one not in use, see VmUploader.
+#define VM_EEPROM_ADDRESS 16 // leave the first bytes for settings
+#define VM_EEPROM_SLOT_ADDRESS (VM_EEPROM_ADDRESS - 1) // slot in use, 1 for the second one
+#define VM_MAGIC 0xB5
+#define VM_HEADER_SIZE 3
+#define VM_MAX_LENGTH 250
+#define VM_SLOT_SIZE (VM_HEADER_SIZE + VM_MAX_LENGTH)
+#define VM_MODE_FRAME 0 // program runs once per frame, drawing through AT
+#define VM_MODE_PIXEL 1 // program runs once per LED, with the cursor on that LED
+#define VM_STACK_SIZE 8
+#define VM_MAX_STEPS 128 // per run in pixel mode, so a bad jump can't hang the firmware
+#define VM_STEPS_PER_LED 16 // added to VM_MAX_STEPS in frame mode, for programs looping over the strip
+
+// Opcodes. Operands are popped in the order they were pushed.
+#define VM_END 0x00
+#define VM_PUSH8 0x01 // (byte immediate) -> value
+#define VM_PUSH16 0x02 // (two byte immediate, low first) -> value
+#define VM_DUP 0x03
+#define VM_POP 0x04
+#define VM_SWAP 0x05
+#define VM_ADD 0x10
+#define VM_SUB 0x11
+#define VM_MUL 0x12
+#define VM_DIV 0x13 // division by zero gives zero
+#define VM_MOD 0x14
+#define VM_AND 0x15
+#define VM_OR 0x16
+#define VM_XOR 0x17
+#define VM_SHL 0x18
+#define VM_SHR 0x19
+#define VM_LT 0x1A
+#define VM_EQ 0x1B
+#define VM_INDEX 0x20 // -> LED index (0 in frame mode)
+#define VM_COUNT 0x21 // -> number of LEDs
+#define VM_TIME 0x22 // -> millis() / 4
+#define VM_BPM 0x23
+#define VM_BEAT 0x24 // -> progress through the beat, 0-255
+#define VM_DROPPING 0x25 // -> 1 while dropping
+#define VM_SIN8 0x30 // angle -> sin8(angle)
+#define VM_SCALE8 0x31 // value scale -> scale8(value, scale)
+#define VM_BEATSIN16 0x32 // bpm low high -> beatsin16(bpm, low, high)
+#define VM_RANDOM8 0x33 // limit -> random8(limit), or random8() for 0
+#define VM_JMP 0x40 // (signed byte immediate) relative to the next instruction
+#define VM_JZ 0x41 // value, (signed byte immediate) jumps when zero
+#define VM_AT 0x50 // position -> move the cursor
+#define VM_PALETTE 0x51 // index brightness -> set the cursor LED to ColorFromPalette()
+#define VM_PALETTE_ADD 0x52 // index brightness -> add ColorFromPalette() to the cursor LED
+#define VM_HSV 0x53 // hue saturation value -> set the cursor LED
+#define VM_FADE 0x54 // amount -> fadeToBlackBy() on all LEDs
+
+/**
+ * Runs a user-defined pattern, stored as bytecode in EEPROM.
+ * This allows new looks without reflashing, see VmUploader.
+ *
+ * The VM is a small stack machine on 16 bit integers, with built-ins
+ * mirroring the FastLED functions the native patterns use.
+ * Code is read from EEPROM as it runs rather than copied, so a program
+ * costs no RAM beyond the stack. Reads wait for EEPROM writes to finish,
+ * so while VmUploader stores a program, the pattern holds its last frame.
+ *
+ * Arithmetic wraps around at 16 bits, as on the AVR.
+ * Invalid programs (or an empty EEPROM) render black,
+ * stack under- and overflows are ignored.
+ */
+class VmPattern: public Pattern {
+  int16_t stack[VM_STACK_SIZE];
+  byte sp = 0;
+  uint16_t address = VM_EEPROM_ADDRESS; // of the slot in use
+  bool valid = false;
+  byte mode = VM_MODE_FRAME;
+  byte length = 0;
+  uint16_t time = 0;
+
+  byte code(byte pc)
+  {
+    return EEPROM.read(address + VM_HEADER_SIZE + pc);
+  }
+
+  void push(int16_t value)
+  {
+    if (sp < VM_STACK_SIZE) {
+      stack[sp++] = value;
+    }
+  }
+
+  int16_t pop()
+  {
+    return sp ? stack[--sp] : 0;
+  }
+
+  /**
+   * Wrap around rather than overflow, which is undefined for signed integers
+   */
+  static int16_t wrap(unsigned int value)
+  {
+    return (int16_t)(uint16_t)value;
+  }
+
+  void run(PatternState *state, uint16_t index)
+  {
+    uint16_t cursor = index;
+    byte pc = 0;
+    sp = 0;
+
+    uint16_t maxSteps = VM_MAX_STEPS;
+    if (mode == VM_MODE_FRAME) {
+      maxSteps += VM_STEPS_PER_LED * state->ledsSize;
+    }
+
+    for (uint16_t steps = 0; steps < maxSteps && pc < length; steps++) {
+      byte op = code(pc++);
+      int16_t a, b, c;
+
+      switch (op) {
+        case VM_END: return;
+        case VM_PUSH8: push(code(pc++)); break;
+        case VM_PUSH16: a = code(pc++); push(wrap(a | ((unsigned int)code(pc++) << 8))); break;
+        case VM_DUP: a = pop(); push(a); push(a); break;
+        case VM_POP: pop(); break;
+        case VM_SWAP: b = pop(); a = pop(); push(b); push(a); break;
+
+        case VM_ADD: b = pop(); a = pop(); push(wrap((unsigned int)a + (unsigned int)b)); break;
+        case VM_SUB: b = pop(); a = pop(); push(wrap((unsigned int)a - (unsigned int)b)); break;
+        case VM_MUL: b = pop(); a = pop(); push(wrap((unsigned int)(uint16_t)a * (uint16_t)b)); break;
+        // -32768 / -1 overflows, dividing by -1 is negating
+        case VM_DIV: b = pop(); a = pop(); push(b == -1 ? wrap(0u - (unsigned int)a) : b ? a / b : 0); break;
+        case VM_MOD: b = pop(); a = pop(); push(b && b != -1 ? a % b : 0); break;
+        case VM_AND: b = pop(); a = pop(); push(a & b); break;
+        case VM_OR: b = pop(); a = pop(); push(a | b); break;
+        case VM_XOR: b = pop(); a = pop(); push(a ^ b); break;
+        case VM_SHL: b = pop(); a = pop(); push(wrap((unsigned int)(uint16_t)a << (b & 15))); break;
+        case VM_SHR: b = pop(); a = pop(); push((uint16_t)a >> (b & 15)); break;
+        case VM_LT: b = pop(); a = pop(); push(a < b); break;
+        case VM_EQ: b = pop(); a = pop(); push(a == b); break;
+
+        case VM_INDEX: push(index); break;
+        case VM_COUNT: push(state->ledsSize); break;
+        case VM_TIME: push(time); break;
+        case VM_BPM: push(bpm); break;
+        case VM_BEAT: push((byte)(beatProgress * 255)); break;
+        case VM_DROPPING: push(isDropping); break;
+
+        case VM_SIN8: push(sin8(pop())); break;
+        case VM_SCALE8: b = pop(); a = pop(); push(scale8(a, b)); break;
+        case VM_BEATSIN16: c = pop(); b = pop(); a = pop(); push(beatsin16(a, b, c)); break;
+        case VM_RANDOM8: a = pop(); push(a > 0 ? fastRandom.below(a) : fastRandom.next() & 0xFF); break;
+
+        case VM_JMP: a = (int8_t)code(pc++); pc += a; break;
+        case VM_JZ: b = (int8_t)code(pc++); a = pop(); if (!a) { pc += b; } break;
+
+        case VM_AT: a = pop(); cursor = constrain(a, 0, state->ledsSize - 1); break;
+        case VM_PALETTE:
+          b = pop(); a = pop();
+          state->leds[cursor] = ColorFromPalette(*state->palette, a, b);
+          break;
+        case VM_PALETTE_ADD:
+          b = pop(); a = pop();
+          state->leds[cursor] += ColorFromPalette(*state->palette, a, b);
+          break;
+        case VM_HSV:
+          c = pop(); b = pop(); a = pop();
+          state->leds[cursor] = CHSV(a, b, c);
+          break;
+        case VM_FADE: fadeToBlackBy(state->leds, state->ledsSize, pop()); break;
+
+        default: return; // unknown opcode
+      }
+    }
+  }
+
+  public:
+    /**
+     * EEPROM address of a program slot
+     * @param live The slot in use, or the other one
+     */
+    static uint16_t slotAddress(bool live)
+    {
+      bool second = EEPROM.read(VM_EEPROM_SLOT_ADDRESS) == 1;
+      return VM_EEPROM_ADDRESS + ((second == live) ? VM_SLOT_SIZE : 0);
+    }
+
+    /**
+     * (Re)load the program header, e.g. after an upload
+     */
+    void setup()
+    {
+      address = slotAddress(true);
+      valid = EEPROM.read(address) == VM_MAGIC;
+      mode = EEPROM.read(address + 1);
+      length = EEPROM.read(address + 2);
+      if (length > VM_MAX_LENGTH) {
+        valid = false;
+      }
+    }
+
+    void loopForState(PatternState *state, byte fade)
+    {
+      if (!valid) {
+        fill_solid(state->leds, state->ledsSize, CRGB::Black);
+        return;
+      }
+#ifdef __AVR__
+      // Every code read would wait out VmUploader's write (about 3.3ms)
+      if (!eeprom_is_ready()) {
+        return;
+      }
+#endif
+
+      time = presentMillis >> 2;
+      if (mode == VM_MODE_PIXEL) {
+        for (uint16_t i = 0; i < state->ledsSize; i++) {
+          run(state, i);
+        }
+      } else {
+        run(state, 0);
+      }
+    }
+};
+
+#endif
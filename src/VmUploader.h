@@ -0,0 +1,154 @@
+#ifndef VmUploader_h
+#define VmUploader_h
+
+#include <EEPROM.h>
+#include "VmPattern.h"
+
+#define VM_CHUNK_SIZE 15 // code bytes per REMOTE_VM_DATA command
+
+// Upload replies
+#define VM_UPLOAD_OK 0
+#define VM_UPLOAD_BUSY 1 // still writing the previous chunk, send it again
+#define VM_UPLOAD_ERROR 2 // out of order, or checksum mismatch, start over
+
+/**
+ * Receives VmPattern programs through RemoteControl (see scripts/vm_assemble.py),
+ * and stores them in EEPROM.
+ *
+ * Uploads go to the slot not in use, a chunk at a time: begin() with mode and length,
+ * data() with up to VM_CHUNK_SIZE code bytes each, and commit() with the checksum,
+ * the XOR of mode, length and all code bytes. Only a verified upload switches slots,
+ * with a single byte write, so broken or stray uploads never touch the running program.
+ *
+ * An EEPROM write takes about 3.3ms, longer than a byte takes to arrive at 9600 baud.
+ * Chunks are kept in RAM and written by update() one byte per loop, whenever the
+ * EEPROM is ready, so uploads don't stall rendering. Until a chunk has been written,
+ * the next one is answered with VM_UPLOAD_BUSY, which paces the sender.
+ */
+class VmUploader {
+  bool _receiving = false; // since begin()
+  byte _mode;
+  byte _length;
+  byte _checksum;
+  byte _received = 0; // code bytes
+  byte _written = 0; // code bytes written to EEPROM
+  byte _chunk[VM_CHUNK_SIZE];
+  byte _chunkStart = 0; // offset of the chunk within the code
+  byte _commitStep = 0; // header and slot bytes left to write
+  uint16_t _address; // of the slot being written
+
+  bool isWriting()
+  {
+    return _written < _received || _commitStep;
+  }
+
+public:
+  /**
+   * Start an upload, dropping any unfinished one
+   */
+  byte begin(byte mode, byte length)
+  {
+    if (_commitStep) {
+      return VM_UPLOAD_BUSY;
+    }
+    if (length > VM_MAX_LENGTH) {
+      _receiving = false;
+      return VM_UPLOAD_ERROR;
+    }
+    _address = VmPattern::slotAddress(false);
+    _mode = mode;
+    _length = length;
+    _checksum = mode ^ length;
+    _received = 0;
+    _written = 0;
+    _receiving = true;
+    return VM_UPLOAD_OK;
+  }
+
+  /**
+   * Receive code bytes, in order
+   * @param offset Of the first byte within the code, a chunk sent again is acknowledged again
+   */
+  byte data(byte offset, const byte *code, byte count)
+  {
+    if (!_receiving || count > VM_CHUNK_SIZE) {
+      return VM_UPLOAD_ERROR;
+    }
+    if (isWriting()) {
+      return VM_UPLOAD_BUSY;
+    }
+    if (offset + count == _received) {
+      return VM_UPLOAD_OK;
+    }
+    if (offset != _received || _received + count > _length) {
+      _receiving = false;
+      return VM_UPLOAD_ERROR;
+    }
+
+    memcpy(_chunk, code, count);
+    _chunkStart = offset;
+    for (byte i = 0; i < count; i++) {
+      _checksum ^= code[i];
+    }
+    _received += count;
+    return VM_UPLOAD_OK;
+  }
+
+  /**
+   * Switch to the uploaded program once the checksum matches, see update()
+   */
+  byte commit(byte checksum)
+  {
+    if (isWriting()) {
+      return VM_UPLOAD_BUSY;
+    }
+    bool complete = _receiving && _received == _length && checksum == _checksum;
+    _receiving = false;
+    if (!complete) {
+      return VM_UPLOAD_ERROR;
+    }
+    _commitStep = 4;
+    return VM_UPLOAD_OK;
+  }
+
+  /**
+   * Write at most one byte to EEPROM, call once per loop
+   * @return True when a program has been committed, and should be loaded
+   */
+  bool update()
+  {
+    if (!isWriting()) {
+      return false;
+    }
+#ifdef __AVR__
+    // Writes run in the background, only start one when the last has finished
+    if (!eeprom_is_ready()) {
+      return false;
+    }
+#endif
+
+    if (_written < _received) {
+      EEPROM.update(_address + VM_HEADER_SIZE + _written, _chunk[_written - _chunkStart]);
+      _written++;
+      return false;
+    }
+
+    // Header with the magic last, then the slot in use
+    switch (_commitStep--) {
+      case 4:
+        EEPROM.update(_address + 1, _mode);
+        return false;
+      case 3:
+        EEPROM.update(_address + 2, _length);
+        return false;
+      case 2:
+        EEPROM.update(_address, VM_MAGIC);
+        return false;
+      default:
+        EEPROM.update(VM_EEPROM_SLOT_ADDRESS, _address == VM_EEPROM_ADDRESS ? 0 : 1);
+        return true;
+    }
+  }
+};
+
+#endif
@@ -1,13 +1,64 @@
-#include <Bounce2.h>
+// FastLED's timing helpers (EVERY_N_MILLISECONDS, beat8() etc.) use systemClock,
+// see get_millisecond_timer() below
+#define USE_GET_MILLISECOND_TIMER
 #include <FastLED.h>
-// #include <EEPROM.h>
+#include <EEPROM.h>
 
 #define DEBUG
 
+// Render the next frame while the current one is transmitted.
+// Needs std::thread and doubles LED memory, so not available on the Nano.
+// #define OUTPUT_PIPELINE_THREADED
+
+// Gamma correct output, fused with colour correction and brightness.
+// Needs a second set of LED buffers, which is tight on the Nano.
+// #define OUTPUT_GAMMA
+
+// Keep fractional levels through gamma and brightness, and dither them over time.
+// Needs OUTPUT_GAMMA, so 3 more bytes per LED (447 for scarf and hat), check scripts/memory_budget.py
+// before relying on it on the Nano. OUTPUT_DITHER_ERROR is more accurate, but costs another 3 bytes per LED.
+// #define OUTPUT_DITHER
+// #define OUTPUT_DITHER_ERROR
+
+// Let patterns render keyframes at a lower rate, and blend between them
+// at OUTPUT_FRAME_LENGTH. Needs two more sets of LED buffers.
+// #define OUTPUT_INTERPOLATION
+
+// Control patterns, palettes and drops by moving (double shake, tilt, jump),
+// see GestureControl for thresholds.
+// #define GESTURES
+
+// Print accelerometer samples as "x,y,z" lines, to record traces for scripts/soak/gestures.cpp.
+// Needs GESTURES.
+// #define GESTURE_TRACE
+
+// Take commands and VmPattern uploads over serial, see RemoteControl and scripts/remote.py.
+// Comment out to save the RAM and flash if nothing talks to the outfit.
+#define REMOTE_CONTROL
+
+// Sync beat, pattern, palette and drops with other devices over serial,
+// with one device as the leader (TX) and the others following (RX).
+// #define SYNC_LEADER
+// #define SYNC_FOLLOWER
+
+// Stream rendered frames over USB, to watch them with scripts/frame_viewer.py.
+// Needs a copy of all LEDs in SRAM, and switches serial to STREAM_BAUD_RATE.
+// #define FRAME_STREAM
+
+// Lower the frame rate while patterns that opt in (see Pattern::isGovernable()) are near-static,
+// up to GOVERNOR_MAX_FRAME_LENGTH.
+// Saves CPU and show() time, see FrameGovernor.
+// #define FRAME_GOVERNOR
+
+#if defined(DEBUG) && defined(FRAME_STREAM)
+  // Text would end up in the middle of streamed frames
+  #undef DEBUG
+#endif
+
 #ifdef DEBUG
   #define DEBUG_PRINT(msg) (Serial.println(msg))
 #else
-  #define DEBUG_PRINT(msg) ()
+  #define DEBUG_PRINT(msg) ((void)0)
 #endif
 
 // Digital PINs
@@ -24,13 +75,36 @@
 #define ACCELZ_PIN A4
 
 // Other constants
-#define BAUD_RATE 9600
-#define NUM_LEDS_CH0 120
-#define NUM_LEDS_CH1 29
+#define STREAM_BAUD_RATE 115200
+#ifdef FRAME_STREAM
+  #define BAUD_RATE STREAM_BAUD_RATE
+#else
+  #define BAUD_RATE 9600
+#endif
 #define FRAME_LENGTH 33 // 30 fps
-#define NUM_STATES 2
+#define OUTPUT_FRAME_LENGTH 16 // 60 fps, for interpolated patterns
+#define GOVERNOR_MAX_FRAME_LENGTH 100 // 10 fps, with FRAME_GOVERNOR
+#define SCHEDULE_BEATS 1 // pattern and palette changes wait for: 1 = next beat, 2 = half bar, 4 = bar
+#define SCHEDULE_PREROLL_MILLIS FRAME_LENGTH // set up the next pattern this far ahead of the change
+#define DROP_SNAP_DIVISOR 4 // drops pressed within a quarter beat ahead of a beat wait for it
+#define LATENCY_TRIM_MILLIS 0 // added to the measured output latency, e.g. for a delayed sound system
 #define MAX_MILLIAMPS 500 // should run for ~8h on 2x2000maH 18650
-
+#define RANDOM_SEED 0 // set to a logged seed to replay the same sparkles, 0 for a new one on every start
+
+// Channels (LED strips), add one entry per strip.
+// Sizes are 16 bit, so a single strip can hold more than 255 LEDs.
+#include <ChannelList.h>
+typedef ChannelList<
+  Channel<LED_PIN_CH1, 120, TypicalLEDStrip>, // scarf
+  Channel<LED_PIN_CH2, 29, TypicalLEDStrip> // hat
+> Channels;
+#define NUM_STATES Channels::count
+
+// Logical strip which mapped patterns (e.g. Bpm) render to once,
+// before it's mapped onto every channel. Covers half a scarf.
+#define LOGICAL_LEDS 60
+
+#include <OutputPipeline.h>
 #include <Pattern.h>
 #include <PatternList.h>
 #include <PatternState.h>
@@ -42,29 +116,90 @@
 #include <Confetti.h>
 #include <Heartbeat.h>
 #include <Bpm.h>
+#include <Fire.h>
+#include <VmPattern.h>
+#include <VmUploader.h>
 
+#include <ButtonEvents.h>
 #include <BrightnessControl.h>
 #include <ModeControl.h>
 #include <BeatControl.h>
 #include <DropControl.h>
 #include <AccellerationControl.h>
+#include <GestureControl.h>
+#include <MemoryMonitor.h>
+#include <BeatScheduler.h>
+#include <Sequencer.h>
+#include <Playlist.h>
+#include <BeatSync.h>
+#include <FrameStreamer.h>
+#include <FrameGovernor.h>
+#include <Clock.h>
+#include <LatencyMonitor.h>
+#include <RemoteControl.h>
+
+Channels channels;
+
+CRGB logicalLeds[LOGICAL_LEDS];
+byte logicalActive[(LOGICAL_LEDS + 7) / 8];
+byte logicalActivation[LOGICAL_LEDS]; // e.g. Fire's heat
+PatternState logicalState(LOGICAL_LEDS, logicalLeds, logicalActive, logicalActivation);
+
+// Physical layout of each channel on the logical strip.
+// Both scarf halves run from its ends to the centre,
+// the hat ring mirrors around its front.
+const MapSegment scarfMapping[] PROGMEM = {
+  {60, 0, 256},
+  {60, 59, -256}
+};
+const MapSegment hatMapping[] PROGMEM = {
+  {15, 0, 256},
+  {14, 13, -256}
+};
 
-CRGB ledsCh0[NUM_LEDS_CH0];
-PatternState stateCh0(NUM_LEDS_CH0, ledsCh0);
+// What each channel runs, e.g. {5, 100} for Confetti at 10 fps.
+// CHANNEL_FOLLOW runs the pattern picked with the mode button, 0 its own frame length.
+// Mapped patterns (Bpm, Heartbeat, Fire) can only be followed, see PatternList::assign().
+// Following them at a frame length of its own, a channel shows their latest frame at that rate.
+const ChannelPlan channelPlans[NUM_STATES] PROGMEM = {
+  {CHANNEL_FOLLOW, 0}, // scarf
+  {CHANNEL_FOLLOW, 0} // hat
+};
 
-CRGB ledsCh1[NUM_LEDS_CH1];
-PatternState stateCh1(NUM_LEDS_CH1, ledsCh1);
+/**
+ * Read a channel's plan from PROGMEM
+ */
+ChannelPlan channelPlan(byte index)
+{
+  ChannelPlan plan;
+  memcpy_P(&plan, &channelPlans[index], sizeof(ChannelPlan));
+  return plan;
+}
+byte followingStates = 0; // channels on the current pattern and frame length, see setup()
+uint32_t channelKeyframeMillis[NUM_STATES];
+
+OutputPipeline<Channels> output(channels);
+#ifdef FRAME_STREAM
+FrameStreamer<Channels> frameStreamer(channels);
+#endif
 
 Heartbeat *heartbeat = new Heartbeat();
+VmPattern *vmPattern = new VmPattern();
 Pattern *patternItems[] = {
   new Bpm(),
   heartbeat,
   new Plasma(),
   new Juggle(),
   new Sinelon(),
-  new Confetti()
+  new Confetti(),
+  vmPattern,
+  new Fire()
 };
-PatternList patternList(6, patternItems);
+PatternList patternList(8, patternItems);
+#ifdef REMOTE_CONTROL
+VmUploader vmUploader;
+RemoteControl remoteControl;
+#endif
 
 CRGBPalette16 *paletteItems[] = {
   new CRGBPalette16(
@@ -114,15 +249,56 @@ CRGBPalette16 *paletteItems[] = {
 };
 PaletteList paletteList(3, paletteItems);
 
+/**
+ * Heap new'ed above, for scripts/memory_budget.py. Emits no code.
+ */
+void reportHeap()
+{
+  MEMORY_REPORT_HEAP(Bpm, Bpm, 1);
+  MEMORY_REPORT_HEAP(Heartbeat, Heartbeat, 1);
+  MEMORY_REPORT_HEAP(Plasma, Plasma, 1);
+  MEMORY_REPORT_HEAP(Juggle, Juggle, 1);
+  MEMORY_REPORT_HEAP(Sinelon, Sinelon, 1);
+  MEMORY_REPORT_HEAP(Confetti, Confetti, 1);
+  MEMORY_REPORT_HEAP(VmPattern, VmPattern, 1);
+  MEMORY_REPORT_HEAP(Fire, Fire, 1);
+  MEMORY_REPORT_HEAP(palettes, CRGBPalette16, 3);
+}
+
 
+ButtonEvents buttonEvents;
 BrightnessControl brightnessControl(BRIGHTNESS_BUTTON_PIN);
 ModeControl modeControl(MODE_BUTTON_PIN);
 BeatControl beatControl(BEAT_BUTTON_PIN);
 DropControl dropControl(DROP_BUTTON_PIN);
 AccellerationControl accellerationControl(ACCELX_PIN, ACCELY_PIN, ACCELZ_PIN);
+#ifdef GESTURES
+GestureControl gestureControl(MODE_BUTTON_PIN, DROP_BUTTON_PIN);
+#endif
+MemoryMonitor memoryMonitor;
+LatencyMonitor latencyMonitor(OutputPipeline<Channels>::pendingMillis(), LATENCY_TRIM_MILLIS);
+BeatScheduler beatScheduler(SCHEDULE_BEATS, SCHEDULE_PREROLL_MILLIS);
+bool isDropping = false;
+Sequencer sequencer(playlist, PLAYLIST_STEPS);
+#ifdef FRAME_GOVERNOR
+FrameGovernor frameGovernor(GOVERNOR_MAX_FRAME_LENGTH);
+#endif
+#if defined(SYNC_LEADER) || defined(SYNC_FOLLOWER)
+BeatSync beatSync(BAUD_RATE);
+#endif
+#ifdef SYNC_LEADER
+byte syncedPattern = 0; // as last sent, including queued changes
+byte syncedPalette = 0;
+#endif
+
+uint32_t get_millisecond_timer()
+{
+  return systemClock.millis();
+}
 
 // See https://learn.adafruit.com/multi-tasking-the-arduino-part-1/using-millis-for-timing
-long previousMillis = 0;
+uint32_t previousMillis = 0;
+uint32_t previousKeyframeMillis = 0;
 
 // // Cycle mode in persistent memory on every on switch.
 // // More resilient against hardware failures than a button.
@@ -136,62 +312,346 @@ long previousMillis = 0;
 //   EEPROM.write(0, mode);
 // }
 
+#ifdef __AVR__
+// Pin change interrupts for all ports, buttons can be on any pin
+ISR(PCINT0_vect)
+{
+  buttonEvents.handleInterrupt();
+}
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
+#endif
+
+void setPalette(CRGBPalette16 *palette)
+{
+  for(byte i = 0; i < NUM_STATES; i++) {
+    channels.getState(i)->palette = palette;
+  }
+  logicalState.palette = palette;
+}
+
+/**
+ * Time of the next beat boundary that pattern and palette changes snap to
+ */
+uint32_t nextBoundaryMillis(uint32_t currentMillis)
+{
+  return currentMillis + beatControl.millisUntilBeat(beatScheduler.getBeatsPerBoundary());
+}
+
+/**
+ * Queue pattern or palette steps, see BeatScheduler
+ */
+void scheduleChange(bool palette, byte steps, uint32_t dueMillis)
+{
+  if(palette) {
+    beatScheduler.schedulePalette(dueMillis, steps);
+  } else {
+    beatScheduler.schedulePattern(dueMillis, steps);
+  }
+}
+
+/**
+ * Pattern or palette index once queued steps have been applied
+ */
+byte queuedIndex(bool palette)
+{
+  if(palette) {
+    return (paletteList.getIndex() + beatScheduler.getPaletteSteps()) % paletteList.getCount();
+  }
+  return (patternList.getIndex() + beatScheduler.getPatternSteps()) % patternList.getCount();
+}
+
+/**
+ * Queue a switch to a specific pattern or palette, after any steps queued already
+ */
+void scheduleSelect(bool palette, byte index, uint32_t dueMillis)
+{
+  byte count = palette ? paletteList.getCount() : patternList.getCount();
+  byte steps = (index % count + count - queuedIndex(palette)) % count;
+  if(steps) {
+    scheduleChange(palette, steps, dueMillis);
+  }
+}
+
+/**
+ * Start or stop a drop, snapped to the beat when requested just ahead of it
+ */
+void requestDrop(bool drop, uint32_t currentMillis)
+{
+  uint32_t snapMillis = beatControl.getBeatLength() / DROP_SNAP_DIVISOR;
+  if(beatScheduler.scheduleDrop(drop, currentMillis, beatControl.millisUntilBeat(1), snapMillis)) {
+    isDropping = drop;
+  }
+}
+
+#ifdef REMOTE_CONTROL
+/**
+ * Act on a command received through remoteControl,
+ * through the same controls and scheduler as the buttons
+ */
+void handleRemote(uint32_t currentMillis)
+{
+  byte *payload = remoteControl.getPayload();
+  byte length = remoteControl.getLength();
+  switch(remoteControl.getCommand()) {
+    case REMOTE_SET_PATTERN:
+      if(length >= 1) {
+        scheduleSelect(false, payload[0], nextBoundaryMillis(currentMillis));
+      }
+      break;
+    case REMOTE_SET_PALETTE:
+      if(length >= 1) {
+        scheduleSelect(true, payload[0], nextBoundaryMillis(currentMillis));
+      }
+      break;
+    case REMOTE_SET_BEAT:
+      if(length >= 4) {
+        uint16_t beatLength = remoteControl.readWord(0);
+        uint16_t barPhase = remoteControl.readWord(2);
+        int32_t correction = 0;
+        if(barPhase != 0xFFFF) {
+          correction = (int32_t)barPhase - (int32_t)beatControl.barPhase();
+        }
+        beatControl.follow(beatLength, correction);
+      }
+      break;
+    case REMOTE_DROP:
+      if(length >= 1) {
+        requestDrop(payload[0], currentMillis);
+      }
+      break;
+    case REMOTE_SET_BRIGHTNESS:
+      if(length >= 1) {
+        brightnessControl.setLevel(payload[0]);
+      }
+      break;
+    case REMOTE_QUERY_STATS: {
+      uint16_t beatLength = beatControl.getBeatLength();
+      uint16_t freeBytes = memoryMonitor.getMinFreeBytes();
+      uint16_t latency = latencyMonitor.getMeasuredMillis();
+      uint32_t lost = systemClock.getLostMillis();
+      byte stats[14] = {
+        patternList.getIndex(),
+        paletteList.getIndex(),
+        brightnessControl.getLevel(),
+        (byte)((isDropping ? 1 : 0) | (sequencer.isEnabled() ? 2 : 0)),
+        (byte)(beatLength & 0xFF), (byte)(beatLength >> 8),
+        (byte)(freeBytes & 0xFF), (byte)(freeBytes >> 8),
+        (byte)(latency & 0xFF), (byte)(latency >> 8),
+        (byte)(lost & 0xFF), (byte)(lost >> 8), (byte)(lost >> 16), (byte)(lost >> 24)
+      };
+      remoteControl.reply(Serial, stats, sizeof(stats));
+      break;
+    }
+    case REMOTE_PING:
+      remoteControl.reply(Serial, payload, length);
+      break;
+    case REMOTE_VM_BEGIN:
+      remoteControl.reply(Serial, length >= 2 ? vmUploader.begin(payload[0], payload[1]) : VM_UPLOAD_ERROR);
+      break;
+    case REMOTE_VM_DATA:
+      remoteControl.reply(Serial, length >= 1 ? vmUploader.data(payload[0], payload + 1, length - 1) : VM_UPLOAD_ERROR);
+      break;
+    case REMOTE_VM_COMMIT:
+      remoteControl.reply(Serial, length >= 1 ? vmUploader.commit(payload[0]) : VM_UPLOAD_ERROR);
+      break;
+  }
+}
+#endif
+
+/**
+ * Hand the beat and drop state to a pattern about to render
+ */
+void prepareFrame(Pattern *pattern, bool dropping, uint32_t presentMillis)
+{
+  pattern->setBpm(beatControl.getBpm());
+  pattern->setOnBeat(beatControl.onBeat());
+  pattern->setBeatProgress(beatControl.beatProgress());
+  pattern->setIsDropping(dropping);
+  pattern->setPresentMillis(presentMillis);
+}
+
 void setup() {
   // Sanity delay
   delay(500);
 
-  FastLED.addLeds<NEOPIXEL, LED_PIN_CH1>(ledsCh0, NUM_LEDS_CH0);
-  FastLED.addLeds<NEOPIXEL, LED_PIN_CH2>(ledsCh1, NUM_LEDS_CH1);
+  systemClock.setup();
+  channels.setup();
+  output.setup();
 
   Serial.begin(BAUD_RATE);
 
+  memoryMonitor.setup();
+  reportHeap();
+#ifdef DEBUG
+  memoryMonitor.printBoot();
+  memoryMonitor.printPrevious();
+#endif
+
+  // Accelerometer noise and startup timing vary between starts
+  fastRandom.seed(RANDOM_SEED ? RANDOM_SEED : analogRead(ACCELX_PIN) ^ (micros() << 4));
+#ifdef DEBUG
+  Serial.print(F("random seed: "));
+  Serial.println(fastRandom.getSeed());
+#endif
+
   // https://github.com/FastLED/FastLED/wiki/Power-notes#managing-power-in-fastled
-  FastLED.setMaxPowerInVoltsAndMilliamps(5,MAX_MILLIAMPS);
+  output.setMaxPower(5, MAX_MILLIAMPS);
 
-  brightnessControl.setup();
+  brightnessControl.setup(buttonEvents);
   FastLED.setBrightness(brightnessControl.getBrightness());
 
-  modeControl.setup();
+  modeControl.setup(buttonEvents);
 
-  beatControl.setup();
+  beatControl.setup(buttonEvents);
 
-  dropControl.setup();
+  dropControl.setup(buttonEvents);
 
-  stateCh0.palette = paletteList.curr();
-  patternList.setState(0, &stateCh0);
+  for(byte i = 0; i < NUM_STATES; i++) {
+    PatternState *state = channels.getState(i);
+    state->palette = paletteList.curr();
+    patternList.setState(i, state);
+  }
+  for(byte i = 0; i < NUM_STATES; i++) {
+    ChannelPlan plan = channelPlan(i);
+    if(!patternList.assign(i, plan.pattern)) {
+#ifdef DEBUG
+      Serial.print(F("channel: mapped pattern refused on "));
+      Serial.println(i);
+#endif
+    }
+    if(patternList.isFollowing(i) && !plan.frameLength) {
+      followingStates |= 1 << i;
+    }
+  }
+  channels.getState(0)->setMapping(scarfMapping, 2);
+  channels.getState(1)->setMapping(hatMapping, 2);
 
-  stateCh1.palette = paletteList.curr();
-  patternList.setState(1, &stateCh1);
+  logicalState.palette = paletteList.curr();
+  patternList.setLogicalState(&logicalState);
 
   // updateModeFromEEPROM();
 }
 
 void loop() {
-  // Timing
-  unsigned long currentMillis = millis();
+  // Timing, corrected for ticks lost while transmitting LEDs
+  uint32_t currentMillis = systemClock.update();
 
-  // Mode and Palette
+  // Buttons
   modeControl.update();
+  dropControl.update();
+  buttonEvents.update();
+  ButtonEvent event;
+  while(buttonEvents.pop(event)) {
+    modeControl.handle(event);
+    dropControl.handle(event);
+    brightnessControl.handle(event);
+    beatControl.handle(event);
+
+    // Autopilot, toggled by pressing drop while holding mode.
+    // Neither press counts on its own, so this doesn't drop or change the pattern.
+    // Only checked for the buttons, gestures (e.g. a jump holding drop) can't toggle it.
+    if(modeControl.isPressed() && dropControl.fell()) {
+      modeControl.cancel();
+      dropControl.cancel();
+      sequencer.toggle();
+      DEBUG_PRINT(sequencer.isEnabled() ? F("autopilot: on") : F("autopilot: off"));
+    }
+  }
+
+#ifdef GESTURES
+  // Gestures act like mode and drop button presses
+  EVERY_N_MILLISECONDS(GESTURE_SAMPLE_MILLIS) {
+    int x, y, z;
+    accellerationControl.read(x, y, z);
+    gestureControl.update(x, y, z, currentMillis);
+#ifdef GESTURE_TRACE
+    Serial.print(x);
+    Serial.print(',');
+    Serial.print(y);
+    Serial.print(',');
+    Serial.println(z);
+#endif
+  }
+  while(gestureControl.pop(event)) {
+    modeControl.handle(event);
+    dropControl.handle(event);
+  }
+#endif
+
+  // Beat, as of the time the next frame will be visible
+  uint32_t lookahead = latencyMonitor.getLookaheadMillis();
+  beatControl.setLookahead(lookahead);
+  beatControl.update(currentMillis);
+
+  // Mode and Palette, changed on the beat
   if(modeControl.rose()) {
-    if(modeControl.wasLongPress()) {
-      CRGBPalette16 *palette = paletteList.next();
-      stateCh0.palette = palette;
-      stateCh1.palette = palette;
-    } else {
-      patternList.next();
+    scheduleChange(modeControl.wasLongPress(), 1, nextBoundaryMillis(currentMillis));
+  }
+  if(beatScheduler.shouldPrepare(currentMillis)) {
+    patternList.prepare(beatScheduler.getPatternSteps());
+  }
+  if(beatScheduler.isDue(currentMillis)) {
+    byte patternSteps = beatScheduler.takePatternSteps();
+    if(patternSteps) {
+      patternList.advance(patternSteps);
+    }
+    byte paletteSteps = beatScheduler.takePaletteSteps();
+    if(paletteSteps) {
+      setPalette(paletteList.advance(paletteSteps));
+    }
+  }
+
+  // Autopilot
+  if(sequencer.update(beatControl.onBar())) {
+    // Queued for the next bar, the scheduler sets the pattern up ahead of it
+    uint32_t dueMillis = currentMillis + beatControl.millisUntilBeat(4);
+    int8_t pattern = sequencer.getPattern(patternList.getCount());
+    if(pattern >= 0) {
+      scheduleSelect(false, pattern, dueMillis);
+    }
+    int8_t palette = sequencer.getPalette(paletteList.getCount());
+    if(palette >= 0) {
+      scheduleSelect(true, palette, dueMillis);
     }
   }
   Pattern *currPattern = patternList.curr();
 
-  // Beat
-  beatControl.update();
-  currPattern->setBpm(beatControl.getBpm());
-  currPattern->setOnBeat(beatControl.onBeat());
-  currPattern->setBeatProgress(beatControl.beatProgress());
+  // Drop, snapped to the beat when pressed just ahead of it
+  if(dropControl.fell() != dropControl.rose()) {
+    requestDrop(dropControl.fell(), currentMillis);
+  }
+  if(beatScheduler.isDropDue(currentMillis)) {
+    isDropping = beatScheduler.takeDrop();
+  }
+  bool dropping = isDropping || sequencer.isDropping();
+#ifdef SYNC_FOLLOWER
+  dropping = dropping || beatSync.isDropping(currentMillis);
+#endif
+  prepareFrame(currPattern, dropping, currentMillis + lookahead);
+#ifdef FRAME_GOVERNOR
+  frameGovernor.setIsDropping(dropping);
+#endif
 
-  // Drop
-  dropControl.update();
-  currPattern->setIsDropping((dropControl.read() == LOW));
+#ifdef SYNC_LEADER
+  // Queued changes go out right away, so followers can queue them for the same boundary
+  bool syncDue = queuedIndex(false) != syncedPattern || queuedIndex(true) != syncedPalette;
+  EVERY_N_MILLISECONDS(SYNC_INTERVAL_MILLIS) {
+    syncDue = true;
+  }
+  if(syncDue) {
+    syncedPattern = queuedIndex(false);
+    syncedPalette = queuedIndex(true);
+    beatSync.send(
+      Serial,
+      beatControl.getBeatLength(),
+      beatControl.barPhase(),
+      syncedPattern,
+      syncedPalette,
+      dropping
+    );
+  }
+#endif
 
   // Accelleration
   int magnitude;
@@ -200,21 +660,126 @@ void loop() {
     accellerationControl.update();
     magnitude = accellerationControl.getAdjustedMagnitude();
     heartbeat->setMagnitude(magnitude);
+#ifdef FRAME_GOVERNOR
+    frameGovernor.setMotion(magnitude);
+#endif
+  }
+
+#if defined(REMOTE_CONTROL) || defined(SYNC_FOLLOWER)
+  // Serial input: remote commands (including VmPattern uploads), and sync frames from a leader
+  while(Serial.available()) {
+    byte b = Serial.read();
+#ifdef REMOTE_CONTROL
+    if(remoteControl.receive(b, currentMillis)) {
+      handleRemote(currentMillis);
+    }
+#endif
+#ifdef SYNC_FOLLOWER
+    if(beatSync.receive(b, currentMillis)) {
+      beatControl.follow(beatSync.getBeatLength(), beatSync.getCorrection(beatControl.barPhase()));
+      // Through the scheduler like local changes, so patterns get their pre-roll
+      scheduleSelect(false, beatSync.getPattern(), nextBoundaryMillis(currentMillis));
+      scheduleSelect(true, beatSync.getPalette(), nextBoundaryMillis(currentMillis));
+    }
+#endif
+  }
+#endif
+
+#ifdef REMOTE_CONTROL
+  if(vmUploader.update()) {
+    vmPattern->setup();
+    DEBUG_PRINT(F("vm: stored"));
   }
+#endif
+
+#ifdef FRAME_STREAM
+  // Whatever fits into the serial buffer, between renders
+  frameStreamer.update(Serial);
+#endif
+
+  // Memory
+  EVERY_N_MILLISECONDS(1000) {
+    memoryMonitor.update();
+  }
+#ifdef DEBUG
+  EVERY_N_MILLISECONDS(10000) {
+    memoryMonitor.print();
+    Serial.print(F("clock: lost "));
+    Serial.print(systemClock.getLostMillis());
+    Serial.println(F("ms"));
+    Serial.print(F("latency: "));
+    Serial.print(latencyMonitor.getMeasuredMillis());
+    Serial.println(F("ms"));
+#ifdef FRAME_GOVERNOR
+    Serial.print(F("frame length: "));
+    Serial.println(currPattern->isGovernable() ? frameGovernor.apply(currPattern->getFrameLength()) : currPattern->getFrameLength());
+#endif
+  }
+#endif
 
   // Patterns
   int frameLength = currPattern->getFrameLength();
+  int outputLength = frameLength;
+#ifdef OUTPUT_INTERPOLATION
+  if(currPattern->isInterpolated()) {
+    outputLength = min(OUTPUT_FRAME_LENGTH, frameLength);
+  }
+#endif
+#ifdef FRAME_GOVERNOR
+  int patternLength = frameLength;
+  if(currPattern->isGovernable()) {
+    frameLength = frameGovernor.apply(frameLength);
+    outputLength = frameGovernor.apply(outputLength);
+  }
+#endif
   // Should use EVERY_N_MILLISECONDS, but the C++ macro
   // can't seem to change values dynamically
-  if(currentMillis - previousMillis > frameLength) {
+  if(currentMillis - previousKeyframeMillis > frameLength) {
+    previousKeyframeMillis = currentMillis;
+    latencyMonitor.start(currentMillis);
+    channels.keyframe(followingStates);
+    patternList.loop(0, followingStates);
+#ifdef FRAME_GOVERNOR
+    frameGovernor.measure(channels, followingStates, patternLength);
+#endif
+  }
+
+  if(currentMillis - previousMillis > outputLength) {
     previousMillis = currentMillis;
-    patternList.loop(0);
 
-    // Brightness
-    brightnessControl.update();
-    FastLED.setBrightness(brightnessControl.getBrightness());
+    // Blend towards the latest keyframe, reaching it when the next one is due
+    fract8 progress = 255;
+    if(outputLength < frameLength) {
+      progress = min((currentMillis - previousKeyframeMillis) * 255 / frameLength, 255);
+    }
+    output.present(brightnessControl.getBrightness(), progress, followingStates);
+    latencyMonitor.stop(systemClock.update());
+#ifdef FRAME_STREAM
+    frameStreamer.frameShown(patternList.getIndex());
+#endif
+  }
 
-    FastLED.show();
+  // Channels with a plan of their own, only transmitted when their frame is due
+  byte dueStates = 0;
+  for(byte i = 0; i < NUM_STATES; i++) {
+    if(followingStates & (1 << i)) {
+      continue;
+    }
+    Pattern *pattern = patternList.forState(i);
+    int length = channelPlan(i).frameLength;
+    if(!length) {
+      length = pattern->getFrameLength();
+    }
+    if(currentMillis - channelKeyframeMillis[i] > length) {
+      channelKeyframeMillis[i] = currentMillis;
+      prepareFrame(pattern, dropping, currentMillis + lookahead);
+      dueStates |= 1 << i;
+    }
+  }
+  if(dueStates) {
+    channels.keyframe(dueStates);
+    patternList.loopOwnRate(0, dueStates);
+    output.present(brightnessControl.getBrightness(), 255, dueStates);
   }
 
 }